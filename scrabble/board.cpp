@@ -2,6 +2,7 @@
 #include "board_square.h"
 #include "exceptions.h"
 #include "formatting.h"
+#include "trace.h"
 #include <fstream>
 #include <iomanip>
 
@@ -82,6 +83,27 @@ Board Board::read(const string &file_path) {
 size_t Board::get_move_index() const { return this->move_index; }
 
 PlaceResult Board::test_place(const Move &move) const {
+  vector<string> words;
+  unsigned int points = 0;
+  const char *error = check_place(move, words, points);
+  if (error != nullptr) {
+    return PlaceResult(error);
+  }
+  return PlaceResult(words, points);
+}
+
+const char *Board::test_place(const Move &move,
+                              pmr::vector<pmr::string> &words,
+                              unsigned int &points) const {
+  return check_place(move, words, points);
+}
+
+template <class Words>
+const char *Board::check_place(const Move &move, Words &words,
+                               unsigned int &points) const {
+  typedef typename Words::value_type String;
+  words.clear();
+  points = 0;
 
   bool start_or_neighboring_tile = false;
 
@@ -89,11 +111,11 @@ PlaceResult Board::test_place(const Move &move) const {
 
   // Move must be in bounds
   if (!this->is_in_bounds(cursor))
-    return PlaceResult("Given starting placement must be in bounds");
+    return "Given starting placement must be in bounds";
 
   // Can't start on an existing tile.
   if (this->at(cursor).has_tile()) {
-    return PlaceResult("cannot start a word on an already-placed tile");
+    return "cannot start a word on an already-placed tile";
   }
 
   // Go to start of word
@@ -101,10 +123,9 @@ PlaceResult Board::test_place(const Move &move) const {
     cursor = cursor.translate(move.direction, -1);
   }
 
-  string word = "";
+  String word(words.get_allocator());
   unsigned int total_points = 0;
 
-  vector<string> words;
   unsigned int word_multiplier = 1;
   unsigned int word_points = 0;
 
@@ -112,7 +133,7 @@ PlaceResult Board::test_place(const Move &move) const {
   for (size_t i = 0; i < move.tiles.size() || in_bounds_and_has_tile(cursor);) {
     // Check in bounds
     if (!this->is_in_bounds(cursor)) {
-      return PlaceResult("word placement goes out of bounds");
+      return "word placement goes out of bounds";
     }
 
     const BoardSquare &square = this->at(cursor);
@@ -139,7 +160,7 @@ PlaceResult Board::test_place(const Move &move) const {
           in_bounds_and_has_tile(
               cursor.translate(!move.direction, 1))) { // there is a normal word
         start_or_neighboring_tile = true;
-        string normal_word;
+        String normal_word(words.get_allocator());
         unsigned int normal_word_points = 0;
         unsigned int normal_word_multiplier = 1;
 
@@ -162,38 +183,65 @@ PlaceResult Board::test_place(const Move &move) const {
                  in_bounds_and_has_tile(normal_cursor));
 
         total_points += normal_word_points * normal_word_multiplier;
-        words.push_back(normal_word);
+        words.push_back(std::move(normal_word));
       }
     }
     // advance to next square
     cursor = cursor.translate(move.direction);
   }
   if (word.size() > 1) {
-    words.push_back(word);
+    words.push_back(std::move(word));
     total_points += word_points * word_multiplier;
   }
   if (words.size() == 0) {
-    return PlaceResult("No words formed.");
+    return "No words formed.";
   }
   if (!start_or_neighboring_tile)
-    return PlaceResult(
-        "Words must neighbor placed tile or contain start square.");
-  return PlaceResult(words, total_points);
+    return "Words must neighbor placed tile or contain start square.";
+  points = total_points;
+  return nullptr;
 }
 
 PlaceResult Board::place(const Move &move) {
+  Trace::Span span("Board::place");
   PlaceResult result = this->test_place(move);
   if (result.valid) {
-    Board::Position cursor(move.row, move.column);
-    for (size_t i = 0; i < move.tiles.size();) {
-      if (this->at(cursor).has_tile()) {
-      } else {
-        this->at(cursor).set_tile_kind(move.tiles[i++]);
+    place_tiles(move, nullptr);
+  }
+  return result;
+}
+
+void Board::place_tiles(const Move &move, vector<Position> *placed) {
+  Board::Position cursor(move.row, move.column);
+  for (size_t i = 0; i < move.tiles.size();) {
+    if (!this->at(cursor).has_tile()) {
+      this->at(cursor).set_tile_kind(move.tiles[i++]);
+      if (placed != nullptr) {
+        placed->push_back(cursor);
       }
-      cursor = cursor.translate(move.direction);
     }
+    cursor = cursor.translate(move.direction);
   }
-  return result;
+}
+
+Board::TrialMove::TrialMove(Board &board, const Move &move)
+    : board(board), place_result(board.test_place(move)),
+      on_board(place_result.valid) {
+  if (on_board) {
+    board.place_tiles(move, &squares);
+  }
+}
+
+Board::TrialMove::~TrialMove() { undo(); }
+
+void Board::TrialMove::undo() {
+  if (!on_board) {
+    return;
+  }
+  for (const Position &position : squares) {
+    board.at(position).remove_tile();
+  }
+  on_board = false;
 }
 
 BoardSquare &Board::at(const Board::Position &position) {
@@ -308,64 +356,59 @@ void Board::print(ostream &out) const {
 }
 
 vector<Board::Anchor> Board::get_anchors() const {
+  Trace::Span span("Board::get_anchors");
 
   vector<Anchor> anchors;
 
+  // if board is empty, the start square is the only anchor; otherwise scan
+  // every row and every column
+  for (size_t i = 0; i < rows; i++) {
+    get_line_anchors(Direction::ACROSS, i, anchors);
+  }
+  for (size_t j = 0; j < columns; j++) {
+    get_line_anchors(Direction::DOWN, j, anchors);
+  }
+  return anchors;
+}
+
+void Board::get_line_anchors(Direction direction, size_t line,
+                             vector<Anchor> &anchors) const {
+
   // if board is empty
   if (!at(this->start).has_tile()) {
 
     // create limits for anchor construction; limits look to squares opposite of
     // place direction.
-    size_t limit1 = start.row;
-    size_t limit2 = start.column;
-
-    // construct anchors
-    Anchor a1(start, Direction::DOWN, limit1);
-    Anchor a2(start, Direction::ACROSS, limit2);
-
-    // prep vector for return
-    anchors.push_back(a1);
-    anchors.push_back(a2);
-    return anchors;
+    if (direction == Direction::ACROSS && line == start.row) {
+      anchors.push_back(Anchor(start, Direction::ACROSS, start.column));
+    } else if (direction == Direction::DOWN && line == start.column) {
+      anchors.push_back(Anchor(start, Direction::DOWN, start.row));
+    }
+    return;
   }
 
-  // otherwise, scan entire board from (0,0) for anchors
-  for (size_t i = 0; i < rows; i++) {
-    for (size_t j = 0; j < columns; j++) {
-
-      // current boardsquare of scan
-      Position temp(i, j);
-
-      // if anchor, evaluate limits and push onto vector
-      if (is_anchor_spot(temp)) {
-
-        // look left and above to evaluate limits
-        Position left(i, j - 1);
-        Position above(i - 1, j);
-        size_t limit_left = 0;
-        size_t limit_right = 0;
-        while (is_in_bounds(left) && !in_bounds_and_has_tile(left) &&
-               !is_anchor_spot(left)) {
-          limit_left++;
-          left.column -= 1;
-        }
-        while (is_in_bounds(above) && !in_bounds_and_has_tile(above) &&
-               !is_anchor_spot(above)) {
-          limit_right++;
-          above.row -= 1;
-        }
+  // otherwise, scan the line from its first square for anchors
+  size_t length = direction == Direction::ACROSS ? columns : rows;
+  for (size_t k = 0; k < length; k++) {
+
+    // current boardsquare of scan
+    Position temp = direction == Direction::ACROSS ? Position(line, k)
+                                                   : Position(k, line);
 
-        // construct anchors
-        Anchor a_left(temp, Direction::ACROSS, limit_left);
-        Anchor a_right(temp, Direction::DOWN, limit_right);
+    // if anchor, evaluate limit and push onto vector
+    if (is_anchor_spot(temp)) {
 
-        // build vector for return
-        anchors.push_back(a_left);
-        anchors.push_back(a_right);
+      // look left or above to evaluate limit
+      Position before = temp.translate(direction, -1);
+      size_t limit = 0;
+      while (is_in_bounds(before) && !in_bounds_and_has_tile(before) &&
+             !is_anchor_spot(before)) {
+        limit++;
+        before = before.translate(direction, -1);
       }
+      anchors.push_back(Anchor(temp, direction, limit));
     }
   }
-  return anchors;
 }
 
 bool Board::is_anchor_spot(Position position) const {
@@ -401,3 +444,5 @@ char Board::letter_at(Position p) const {
   else
     return loc_tile.letter;
 }
+
+const BoardSquare &Board::square_at(Position p) const { return at(p); }
@@ -6,6 +6,7 @@
 #include "move.h"
 #include "place_result.h"
 #include "tile_kind.h"
+#include <memory_resource>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -66,10 +67,47 @@ public:
   */
   PlaceResult test_place(const Move &move) const;
 
+  /*
+  Same as test_place(), for callers checking many moves: the words formed
+  replace the contents of words, allocated with its allocator, and points is
+  set to what the move scores. Returns nullptr if the move is valid, or else
+  the error message.
+  */
+  const char *test_place(const Move &move,
+                         std::pmr::vector<std::pmr::string> &words,
+                         unsigned int &points) const;
+
   PlaceResult
   place(const Move &move); // Used for testing - remember that the move struct
                            // should use 0 based indexing, NOT 1 based
 
+  /*
+  A move placed on the board for as long as the TrialMove lives, so that a
+  move can be tried and taken back without copying the board. Only the squares
+  the move filled are kept, and only by the TrialMove: place() keeps no
+  history. An invalid move places nothing.
+  */
+  class TrialMove {
+  public:
+    TrialMove(Board &board, const Move &move);
+    ~TrialMove();
+    TrialMove(const TrialMove &) = delete;
+    TrialMove &operator=(const TrialMove &) = delete;
+
+    // Takes the move back off the board, if it is still on it.
+    void undo();
+
+    const PlaceResult &result() const { return place_result; }
+    // The squares the move filled.
+    const std::vector<Position> &placed() const { return squares; }
+
+  private:
+    Board &board;
+    PlaceResult place_result;
+    std::vector<Position> squares;
+    bool on_board;
+  };
+
   void print(std::ostream &out) const;
 
   // Note: These methods have been made public
@@ -82,6 +120,12 @@ public:
   */
   char letter_at(Position p) const;
 
+  /*
+  Returns the square at a position, including its multipliers.
+  Assumes p is in bounds.
+  */
+  const BoardSquare &square_at(Position p) const;
+
   /* HW5: IMPLEMENT THIS
   Returns bool indicating whether position p is an anchor spot or not.
 
@@ -101,6 +145,14 @@ public:
   */
   std::vector<Anchor> get_anchors() const; // Used for testing
 
+  /*
+  Appends the Anchors of one direction in a single line to anchors: the
+  ACROSS anchors of row `line`, or the DOWN anchors of column `line`.
+  get_anchors() is every row's ACROSS anchors and every column's DOWN anchors.
+  */
+  void get_line_anchors(Direction direction, size_t line,
+                        std::vector<Anchor> &anchors) const;
+
 protected:
   Board(size_t rows, size_t columns, size_t starting_row,
         size_t starting_column)
@@ -111,6 +163,15 @@ private:
   BoardSquare &at(const Position &position);
   const BoardSquare &at(const Position &position) const;
 
+  // The body of both test_place() overloads, for either kind of word list.
+  template <class Words>
+  const char *check_place(const Move &move, Words &words,
+                          unsigned int &points) const;
+
+  // Puts a move that passed test_place() on the board, adding the squares it
+  // fills to `placed` if given.
+  void place_tiles(const Move &move, std::vector<Position> *placed);
+
   std::vector<std::vector<BoardSquare>> squares;
   size_t move_index = 0;
 };
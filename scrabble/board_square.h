@@ -17,6 +17,7 @@ public:
     bool has_tile() const;
     TileKind get_tile_kind() const;
     void set_tile_kind(TileKind kind);
+    void remove_tile();
     unsigned int get_points() const;
 
 private:
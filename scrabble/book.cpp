@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "dictionary.h"
+#include "exceptions.h"
+#include "opening_book.h"
+#include "scrabble_config.h"
+#include "tile_bag.h"
+
+using namespace std;
+
+
+// Opening book tool: finds the best first move for every rack a hand can be
+// dealt from the configured tile bag and writes them to a book that
+// ComputerPlayer can look openings up in (see OpeningBook).
+
+struct Kind {
+    TileKind tile;
+    size_t count;
+};
+
+// Adds every rack of `remaining` more tiles drawn from kinds[first] on to
+// rack, each kind at most as many times as the bag holds it.
+static void add_racks(const vector<Kind>& kinds, size_t first, size_t remaining, vector<TileKind>& rack,
+                      vector<vector<TileKind>>& racks) {
+    if (remaining == 0) {
+        racks.push_back(rack);
+        return;
+    }
+    for (size_t i = first; i < kinds.size(); ++i) {
+        size_t most = min(kinds[i].count, remaining);
+        for (size_t taken = 1; taken <= most; ++taken) {
+            rack.push_back(kinds[i].tile);
+            add_racks(kinds, i + 1, remaining - taken, rack, racks);
+        }
+        rack.erase(rack.end() - most, rack.end());
+    }
+}
+
+static vector<vector<TileKind>> all_racks(const TileBag& bag, size_t hand_size) {
+    vector<Kind> kinds;
+    for (const auto& kind : bag.get_kinds()) {
+        kinds.push_back({kind.second, bag.count_tiles(kind.second)});
+    }
+    sort(kinds.begin(), kinds.end(), [](const Kind& lhs, const Kind& rhs) { return lhs.tile.letter < rhs.tile.letter; });
+
+    vector<vector<TileKind>> racks;
+    vector<TileKind> rack;
+    add_racks(kinds, 0, hand_size, rack, racks);
+    return racks;
+}
+
+static int generate(const ScrabbleConfig& config, const string& book_path, size_t threads) {
+    if (config.hand_size > OpeningBook::MAX_TILES) {
+        throw FileException("BOOK: hands of more than " + to_string(OpeningBook::MAX_TILES) + " tiles are not supported");
+    }
+    Dictionary dictionary = Dictionary::read_parallel(config.dictionary_file_path, threads);
+    Board board = Board::read(config.board_file_path);
+    TileBag bag = TileBag::read(config.tile_bag_file_path, config.seed);
+
+    vector<vector<TileKind>> racks = all_racks(bag, config.hand_size);
+    cout << "Searching " << racks.size() << " racks on " << threads << " threads" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<OpeningBook::Entry> entries = OpeningBook::generate(board, dictionary, racks, config.hand_size, threads);
+    long seconds = chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - start).count();
+
+    OpeningBook::write(book_path, OpeningBook::board_hash(board), dictionary.get_hash(), entries);
+    cout << "Wrote " << entries.size() << " openings to " << book_path << " in " << seconds << " s" << endl;
+    return 0;
+}
+
+// Prints the book's move for a rack, written as its letters with ? for each
+// blank.
+static int lookup(const ScrabbleConfig& config, const string& book_path, const string& letters) {
+    Dictionary dictionary = Dictionary::read(config.dictionary_file_path);
+    Board board = Board::read(config.board_file_path);
+    TileBag bag = TileBag::read(config.tile_bag_file_path, config.seed);
+    shared_ptr<const OpeningBook> book = OpeningBook::open(book_path);
+    if (!book->matches(board, dictionary)) {
+        cout << book_path << " was built for another board or dictionary" << endl;
+        return 1;
+    }
+
+    TileCollection rack;
+    for (char letter : letters) {
+        auto kind = bag.get_kinds().find(tolower(letter));
+        if (kind == bag.get_kinds().end()) {
+            throw FileException("BOOK: unknown tile " + string(1, letter));
+        }
+        rack.add_tile(kind->second);
+    }
+    const OpeningBook::Entry* entry = book->find(OpeningBook::rack_key(rack));
+    if (entry == nullptr) {
+        cout << letters << " is not in " << book_path << endl;
+        return 1;
+    }
+    if (entry->length == 0) {
+        cout << letters << ": pass" << endl;
+        return 0;
+    }
+
+    Move move;
+    OpeningBook::unpack(*entry, rack, move);
+    cout << letters << ": " << (move.direction == Direction::ACROSS ? "-" : "|") << " " << move.row + 1 << " "
+         << move.column + 1 << " ";
+    for (const TileKind& tile : move.tiles) {
+        cout << (tile.letter == TileKind::BLANK_LETTER ? static_cast<char>(toupper(tile.assigned)) : tile.letter);
+    }
+    cout << " for " << entry->points << " points" << endl;
+    return 0;
+}
+
+static int usage(const char* name) {
+    cerr << "Usage: " << name << " generate <configuration file> <book file> [threads]" << endl;
+    cerr << "       " << name << " lookup <configuration file> <book file> <rack>" << endl;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        return usage(argv[0]);
+    }
+    string command = argv[1];
+
+    try {
+        ScrabbleConfig config = ScrabbleConfig::read(argv[2]);
+        if (command == "generate") {
+            size_t threads = argc > 4 ? strtoul(argv[4], nullptr, 10) : thread::hardware_concurrency();
+            return generate(config, argv[3], max<size_t>(threads, 1));
+        } else if (command == "lookup" && argc > 4) {
+            return lookup(config, argv[3], argv[4]);
+        }
+    } catch (const FileException& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return usage(argv[0]);
+}
@@ -1,5 +1,8 @@
 
 #include "computer_player.h"
+#include "scrabble.h"
+#include "trace.h"
+#include <algorithm>
 #include <iostream>
 #include <iterator>
 #include <memory>
@@ -7,351 +10,1521 @@
 
 using namespace std;
 
-void ComputerPlayer::left_part(Board::Position anchor_pos, string partial_word,
-                               Move partial_move,
-                               shared_ptr<Dictionary::TrieNode> node,
-                               size_t limit, TileCollection &remaining_tiles,
-                               vector<Move> &legal_moves, const Board &board,
-                               const Dictionary &d) const {
+// number of search nodes between clock reads when a deadline is set
+static const size_t DEADLINE_CHECK_INTERVAL = 256;
 
-  Move new_move = partial_move;
+// number of anchors the move cache holds before it is emptied
+static const size_t MOVE_CACHE_CAPACITY = 8192;
 
-  // increment move to position w/ lesser limit
-  if (partial_move.direction == Direction::ACROSS)
-    new_move.column -= 1;
-  else
-    new_move.row -= 1;
+// returns whether letter is one of letters, a mask with bit 0 for 'a'
+static bool allows(uint32_t letters, char letter) {
+  return letter >= 'a' && letter <= 'z' && (letters >> (letter - 'a') & 1);
+}
 
-  // each call to left_part calls extend_right
-  extend_right(anchor_pos, partial_word, new_move, node, remaining_tiles,
-               legal_moves, board, d);
+// returns whether tiles holds at least one tile with this letter
+static bool has_letter(const TileCollection &tiles, char letter) {
+  return tiles.count_tiles(TileKind(letter, 0)) > 0;
+}
 
-  // base case
-  if (limit == 0) {
-    extend_right(anchor_pos, partial_word, partial_move, node, remaining_tiles,
-                 legal_moves, board, d);
+// Releases the turn arena when a search ends, first adding what it held to
+// counters (if not null).
+struct ArenaRelease {
+  TurnArena &arena;
+  ComputerPlayer::SearchCounters *counters;
+
+  ~ArenaRelease() {
+    if (counters != nullptr) {
+      counters->arena_allocations += arena.get_allocations();
+      counters->arena_bytes += arena.get_bytes();
+      counters->arena_heap_blocks += arena.get_heap_allocations();
+    }
+    arena.release();
+  }
+};
+
+// returns the most points any single tile in the collection is worth
+static unsigned int best_tile_points(const TileCollection &tiles) {
+  unsigned int best = 0;
+  for (char letter = 'a'; letter <= 'z'; letter++) {
+    if (has_letter(tiles, letter)) {
+      best = max<unsigned int>(best, tiles.lookup_tile(letter).points);
+    }
+  }
+  if (has_letter(tiles, TileKind::BLANK_LETTER)) {
+    best = max<unsigned int>(best,
+                             tiles.lookup_tile(TileKind::BLANK_LETTER).points);
+  }
+  return best;
+}
+
+ComputerPlayer::BoardState::BoardState(const Board &board,
+                                       const Dictionary &dictionary)
+    : dictionary(dictionary), rows(board.rows), columns(board.columns),
+      across(board.rows), down(board.columns),
+      cross_base(board.rows * board.columns * 2, NO_CROSS_WORD),
+      cross_letters(cross_base.size(), ALL_LETTERS) {
+  for (size_t row = 0; row < rows; row++) {
+    board.get_line_anchors(Direction::ACROSS, row, across[row]);
+    for (size_t column = 0; column < columns; column++) {
+      refresh_cross_base(board, Board::Position(row, column));
+    }
+  }
+  for (size_t column = 0; column < columns; column++) {
+    board.get_line_anchors(Direction::DOWN, column, down[column]);
+  }
+}
+
+void ComputerPlayer::BoardState::refresh(
+    const Board &board, const vector<Board::Position> &squares) {
+  vector<bool> rows_touched(rows, false);
+  vector<bool> columns_touched(columns, false);
+  for (const Board::Position &square : squares) {
+    rows_touched[square.row] = true;
+    columns_touched[square.column] = true;
+  }
+
+  // a changed square can make or unmake anchors on either side of it, and so
+  // change the limits of anchors in the neighbouring lines
+  for (size_t row = 0; row < rows; row++) {
+    if (rows_touched[row] || (row > 0 && rows_touched[row - 1]) ||
+        (row + 1 < rows && rows_touched[row + 1])) {
+      across[row].clear();
+      board.get_line_anchors(Direction::ACROSS, row, across[row]);
+    }
+  }
+  for (size_t column = 0; column < columns; column++) {
+    if (columns_touched[column] ||
+        (column > 0 && columns_touched[column - 1]) ||
+        (column + 1 < columns && columns_touched[column + 1])) {
+      down[column].clear();
+      board.get_line_anchors(Direction::DOWN, column, down[column]);
+    }
+  }
+
+  // cross words only run through the changed rows and columns
+  for (size_t row = 0; row < rows; row++) {
+    for (size_t column = 0; column < columns; column++) {
+      if (rows_touched[row] || columns_touched[column]) {
+        refresh_cross_base(board, Board::Position(row, column));
+      }
+    }
+  }
+}
+
+vector<Board::Anchor> ComputerPlayer::BoardState::anchors() const {
+  vector<Board::Anchor> result;
+  for (const vector<Board::Anchor> &line : across) {
+    result.insert(result.end(), line.begin(), line.end());
+  }
+  for (const vector<Board::Anchor> &line : down) {
+    result.insert(result.end(), line.begin(), line.end());
+  }
+  return result;
+}
+
+int ComputerPlayer::BoardState::cross_base_at(Board::Position square,
+                                              Direction direction) const {
+  return cross_base[((direction == Direction::DOWN) * rows + square.row) *
+                        columns +
+                    square.column];
+}
+
+uint32_t
+ComputerPlayer::BoardState::cross_letters_at(Board::Position square,
+                                             Direction direction) const {
+  return cross_letters[((direction == Direction::DOWN) * rows + square.row) *
+                           columns +
+                       square.column];
+}
+
+// points of the perpendicular word an empty square would join, and the
+// letters that make it a word, per direction
+void ComputerPlayer::BoardState::refresh_cross_base(const Board &board,
+                                                    Board::Position square) {
+  for (Direction dir : {Direction::ACROSS, Direction::DOWN}) {
+    int points = 0;
+    bool has_word = false;
+    string before;
+    string after;
+    if (!board.in_bounds_and_has_tile(square)) {
+      Board::Position cursor = square.translate(!dir, -1);
+      while (board.in_bounds_and_has_tile(cursor)) {
+        points += board.square_at(cursor).get_tile_kind().points;
+        before += board.letter_at(cursor);
+        has_word = true;
+        cursor = cursor.translate(!dir, -1);
+      }
+      reverse(before.begin(), before.end());
+      cursor = square.translate(!dir, 1);
+      while (board.in_bounds_and_has_tile(cursor)) {
+        points += board.square_at(cursor).get_tile_kind().points;
+        after += board.letter_at(cursor);
+        has_word = true;
+        cursor = cursor.translate(!dir, 1);
+      }
+    }
+    size_t index = ((dir == Direction::DOWN) * rows + square.row) * columns +
+                   square.column;
+    cross_base[index] = has_word ? points : NO_CROSS_WORD;
+    cross_letters[index] =
+        has_word ? dictionary.cross_letters(before, after) : ALL_LETTERS;
+  }
+}
+
+ComputerPlayer::SearchContext::SearchContext(const Board &board,
+                                             const Dictionary &dictionary,
+                                             const BoardState &state,
+                                             const TileCollection &rack,
+                                             size_t hand_size,
+                                             SearchStats &stats)
+    : board(board), dictionary(dictionary), state(state), rack(rack),
+      packed_rack(rack), hand_size(hand_size), anchor(board.start),
+      direction(Direction::ACROSS),
+      deadline(chrono::steady_clock::time_point::max()), timed_out(false),
+      has_move(false), nodes(0), pruning(false), threshold(0),
+      max_tile_points(best_tile_points(rack)),
+      bingo_possible(rack.count_tiles() == hand_size), stats(stats),
+      counters(nullptr),
+      // a search takes at most one step per square of a line
+      branches(max(board.rows, board.columns) + 1),
+      followers(branches.size()), rack_letters(0), spellable(0),
+      marks(nullptr), marked(nullptr), cross_words(nullptr) {}
+
+ComputerPlayer::PartialScore
+ComputerPlayer::SearchContext::place(PartialScore score, Board::Position square,
+                                     const TileKind &tile) const {
+  const BoardSquare &board_square = board.square_at(square);
+  unsigned int letter_points = tile.points * board_square.letter_multiplier;
+  score.word_points += letter_points;
+  score.word_multiplier *= board_square.word_multiplier;
+
+  int base = state.cross_base_at(square, direction);
+  if (base != BoardState::NO_CROSS_WORD) {
+    score.cross_points +=
+        (base + letter_points) * board_square.word_multiplier;
+  }
+  score.placed++;
+  return score;
+}
+
+bool ComputerPlayer::SearchContext::across_twin(const PackedMove &move) const {
+  // a single tile is always placed on the anchor
+  if (direction != Direction::DOWN || move.length != 1) {
+    return false;
+  }
+  return board.in_bounds_and_has_tile(anchor.translate(Direction::ACROSS, -1)) ||
+         board.in_bounds_and_has_tile(anchor.translate(Direction::ACROSS, 1));
+}
+
+TileKind ComputerPlayer::SearchContext::tile_of(unsigned char packed) const {
+  if (packed & PackedMove::BLANK_FLAG) {
+    return rack.lookup_tile(TileKind::BLANK_LETTER);
+  }
+  return rack.lookup_tile(packed);
+}
+
+bool ComputerPlayer::SearchContext::can_finish(
+    const Dictionary::TrieNode *node) {
+  if (marks == nullptr) {
+    return true;
+  }
+  uint8_t &mark = (*marks)[node->id];
+  if (mark == UNMARKED) {
+    if (counters != nullptr) {
+      counters->lexicon_marks++;
+    }
+    bool finishes = node->is_final;
+    map<char, shared_ptr<Dictionary::TrieNode>>::const_iterator it =
+        node->nexts.begin();
+    for (; !finishes && it != node->nexts.end(); it++) {
+      finishes = it->first >= 'a' && it->first <= 'z' &&
+                 (spellable >> (it->first - 'a') & 1) &&
+                 can_finish(it->second.get());
+    }
+    mark = finishes ? FINISHES : DEAD_END;
+    marked->push_back(node->id);
+  }
+  if (mark == DEAD_END && counters != nullptr) {
+    counters->subtrees_cut++;
+  }
+  return mark == FINISHES;
+}
+
+void ComputerPlayer::SearchContext::spell_with(uint32_t letters) {
+  if (marks == nullptr || letters == spellable) {
     return;
   }
+  for (uint32_t id : *marked) {
+    (*marks)[id] = UNMARKED;
+  }
+  marked->clear();
+  spellable = letters;
+}
 
-  // check for blank
-  bool has_blank = false;
-  try {
-    TileKind blank = remaining_tiles.lookup_tile('?');
-    has_blank = true;
-  } catch (out_of_range &oor) {
+bool ComputerPlayer::SearchContext::advance(size_t step, char letter) {
+  const vector<Branch> &from = branches[step];
+  vector<Branch> &to = branches[step + 1];
+  to.clear();
+  for (size_t i = 0; i < from.size(); i++) {
+    map<char, shared_ptr<Dictionary::TrieNode>>::const_iterator it =
+        from[i].node->nexts.find(letter);
+    if (it != from[i].node->nexts.end() && can_finish(it->second.get())) {
+      to.push_back({it->second.get(), i, '\0'});
+    }
   }
+  return !to.empty();
+}
 
-  // iterate through all possible prefix combos available in trie
-  map<char, shared_ptr<Dictionary::TrieNode>>::iterator it =
-      node->nexts.begin();
-
-  for (; it != node->nexts.end(); it++) {
-    try {
-      // Call for blank tile
-      if (has_blank) {
-        TileKind tk2 = remaining_tiles.lookup_tile('?');
-
-        // if so, add tile to front of partial word & check for prefix
-        string temp_string;
-        temp_string.push_back(it->first);
-        temp_string += partial_word;
-        shared_ptr<Dictionary::TrieNode> trie_this = d.find_prefix(temp_string);
-        if (trie_this == nullptr)
-          return;
-
-        // if prefix exists, update blank assigned & partial move
-        tk2.assigned = it->first;
-        partial_move.tiles.insert(partial_move.tiles.begin(), tk2);
-
-        // sandwich recursion, since blank tile, unassign upon return
-        remaining_tiles.remove_tile(tk2);
-        left_part(anchor_pos, temp_string, partial_move, node, limit - 1,
-                  remaining_tiles, legal_moves, board, d);
-        tk2.assigned = '\0';
-        remaining_tiles.add_tile(tk2);
-
-        // backstep
-        temp_string.erase(0, 1);
-        partial_move.tiles.erase(partial_move.tiles.begin());
-      }
-      // check for non-blank tile in hand
-      TileKind tk = remaining_tiles.lookup_tile(it->first);
-
-      // if so, add tile to front of partial word & check for prefix
-      string temp_string;
-      temp_string.push_back(it->first);
-      temp_string += partial_word;
-      shared_ptr<Dictionary::TrieNode> trie_this = d.find_prefix(temp_string);
-      if (trie_this == nullptr)
-        return;
+template <class TryTile>
+void ComputerPlayer::SearchContext::each_next_tile(
+    size_t step, const PackedRack &remaining_tiles, uint32_t letters,
+    TryTile try_tile) {
+  const vector<Branch> &from = branches[step];
+  vector<Branch> &to = branches[step + 1];
 
-      // if prefix exists, update partial move
-      partial_move.tiles.insert(partial_move.tiles.begin(), tk);
+  if (from.size() == 1) {
+    // a single node: only its children can follow
+    const Dictionary::TrieNode *node = from[0].node;
+    if (counters != nullptr) {
+      counters->rack_lookups += node->nexts.size();
+    }
+    map<char, shared_ptr<Dictionary::TrieNode>>::const_iterator it =
+        node->nexts.begin();
+    for (; it != node->nexts.end(); it++) {
+      if (remaining_tiles.has(it->first) && allows(letters, it->first) &&
+          can_finish(it->second.get())) {
+        to.assign(1, {it->second.get(), 0, '\0'});
+        try_tile(remaining_tiles.lookup_tile(it->first));
+      }
+    }
+  } else {
+    // every child of every branch a rack tile can follow, in one pass, sorted
+    // by letter so that each letter's branches are together
+    size_t starts[PackedRack::KINDS + 1] = {0};
+    for (const Branch &branch : from) {
+      if (counters != nullptr) {
+        counters->rack_lookups += branch.node->nexts.size();
+      }
+      for (const auto &next : branch.node->nexts) {
+        if (remaining_tiles.has(next.first) && allows(letters, next.first)) {
+          starts[PackedRack::index(next.first) + 1]++;
+        }
+      }
+    }
+    for (size_t kind = 0; kind < PackedRack::KINDS; kind++) {
+      starts[kind + 1] += starts[kind];
+    }
+    vector<Branch> &sorted = followers[step];
+    sorted.resize(starts[PackedRack::KINDS]);
+    size_t ends[PackedRack::KINDS];
+    copy(starts, starts + PackedRack::KINDS, ends);
+    for (size_t i = 0; i < from.size(); i++) {
+      for (const auto &next : from[i].node->nexts) {
+        if (remaining_tiles.has(next.first) && allows(letters, next.first)) {
+          sorted[ends[PackedRack::index(next.first)]++] = {
+              next.second.get(), i, '\0'};
+        }
+      }
+    }
 
-      // sandwich recursion
-      remaining_tiles.remove_tile(tk);
-      left_part(anchor_pos, temp_string, partial_move, node, limit - 1,
-                remaining_tiles, legal_moves, board, d);
-      remaining_tiles.add_tile(tk);
+    for (size_t kind = 0; kind < PackedRack::BLANK; kind++) {
+      if (starts[kind] < ends[kind]) {
+        to.assign(sorted.begin() + starts[kind], sorted.begin() + ends[kind]);
+        try_tile(remaining_tiles.lookup_tile('a' + kind));
+      }
+    }
+  }
 
-      // backstep
-      temp_string.erase(0, 1);
-      partial_move.tiles.erase(partial_move.tiles.begin());
+  // a blank follows every child of every branch at once
+  if (counters != nullptr) {
+    counters->rack_lookups++;
+  }
+  if (remaining_tiles.has(TileKind::BLANK_LETTER)) {
+    to.clear();
+    for (size_t i = 0; i < from.size(); i++) {
+      for (const auto &next : from[i].node->nexts) {
+        if (allows(letters, next.first)) {
+          to.push_back({next.second.get(), i, next.first});
+        }
+      }
+    }
+    if (!to.empty()) {
+      try_tile(remaining_tiles.lookup_tile(TileKind::BLANK_LETTER));
+    }
+  }
+}
 
-    } catch (out_of_range &oor) {
-      continue;
-    } catch (exception &e) {
+void ComputerPlayer::SearchContext::emit(
+    PackedMove move, size_t step, pmr::vector<PackedMove> &legal_moves) {
+  const vector<Branch> &ends = branches[step];
+  for (size_t i = 0; i < ends.size(); i++) {
+    if (!ends[i].node->is_final) {
       continue;
     }
+
+    // walk back to the first step, giving each blank passed its letter
+    size_t tile = move.length;
+    size_t branch = i;
+    for (size_t back = step; back > 0; back--) {
+      const Branch &taken = branches[back][branch];
+      if (taken.letter != '\0') {
+        do {
+          tile--;
+        } while (!(move.tiles[tile] & PackedMove::BLANK_FLAG));
+        move.tiles[tile] = PackedMove::BLANK_FLAG |
+                           static_cast<unsigned char>(taken.letter);
+      }
+      branch = taken.parent;
+    }
+
+    legal_moves.push_back(move);
+    move.alternative = true;
+    if (counters != nullptr) {
+      counters->candidates_emitted++;
+    }
+  }
+}
+
+bool ComputerPlayer::SearchContext::fits(Board::Position square, size_t step,
+                                         size_t tiles_left) const {
+  size_t shortest = UINT8_MAX;
+  for (const Branch &branch : branches[step]) {
+    shortest = min<size_t>(shortest, branch.node->min_length);
+  }
+  size_t empties = 0;
+  for (size_t i = 0; i < shortest; i++) {
+    if (!board.is_in_bounds(square)) {
+      return false;
+    }
+    if (!board.square_at(square).has_tile() && ++empties > tiles_left) {
+      return false;
+    }
+    square = square.translate(direction, 1);
   }
-  // increment move to position w/ lesser limit
-  if (partial_move.direction == Direction::ACROSS)
-    partial_move.column += 1;
-  else
-    partial_move.row += 1;
+  return true;
+}
 
-  // recursive call w/ lesser limit
-  left_part(anchor_pos, partial_word, partial_move, node, limit - 1,
-            remaining_tiles, legal_moves, board, d);
+size_t ComputerPlayer::SearchContext::longest(size_t step) const {
+  size_t most = 0;
+  for (const Branch &branch : branches[step]) {
+    most = max<size_t>(most, branch.node->max_length);
+  }
+  return most;
 }
 
-void ComputerPlayer::extend_right(Board::Position square, string partial_word,
-                                  Move partial_move,
-                                  shared_ptr<Dictionary::TrieNode> node,
-                                  TileCollection &remaining_tiles,
-                                  vector<Move> &legal_moves, const Board &board,
-                                  const Dictionary &d) const {
+unsigned int ComputerPlayer::SearchContext::bound(
+    Board::Position square, const PartialScore &score,
+    const PackedRack &remaining_tiles, size_t reach) const {
+  size_t tiles_left = remaining_tiles.count_tiles();
+  unsigned int board_points = 0;
+  unsigned int word_multiplier = 1;
+  unsigned int letter_multiplier = 1;
+  unsigned int cross_points = 0;
+  size_t empties = 0;
+
+  // every square the rest of the move could cover, including board tiles
+  // directly after the last one
+  while (board.is_in_bounds(square) &&
+         (empties < reach || board.in_bounds_and_has_tile(square))) {
+    const BoardSquare &board_square = board.square_at(square);
+    if (board_square.has_tile()) {
+      board_points += board_square.get_tile_kind().points;
+    } else {
+      word_multiplier *= board_square.word_multiplier;
+      letter_multiplier =
+          max<unsigned int>(letter_multiplier, board_square.letter_multiplier);
+      int base = state.cross_base_at(square, direction);
+      if (base != BoardState::NO_CROSS_WORD) {
+        cross_points += (base + max_tile_points *
+                                    board_square.letter_multiplier) *
+                        board_square.word_multiplier;
+      }
+      empties++;
+    }
+    square = square.translate(direction, 1);
+  }
+
+  unsigned int word_points =
+      (score.word_points + board_points +
+       remaining_tiles.total_points() * letter_multiplier) *
+      score.word_multiplier * word_multiplier;
+  unsigned int bingo = bingo_possible && empties >= tiles_left
+                           ? Scrabble::EMPTY_HAND_BONUS
+                           : 0;
+  return word_points + score.cross_points + cross_points + bingo;
+}
 
-  // if move passed is valid, include it!
-  if (node->is_final) {
-    legal_moves.push_back(partial_move);
+bool ComputerPlayer::SearchContext::out_of_time() {
+  if (deadline == chrono::steady_clock::time_point::max() || !has_move) {
+    return false;
+  }
+  if (!timed_out && ++nodes % DEADLINE_CHECK_INTERVAL == 0) {
+    timed_out = chrono::steady_clock::now() >= deadline;
+  }
+  return timed_out;
+}
+
+void ComputerPlayer::set_time_budget(chrono::milliseconds budget) {
+  time_budget = budget;
+}
+
+chrono::milliseconds ComputerPlayer::get_time_budget() const {
+  return time_budget;
+}
+
+const ComputerPlayer::SearchStats &ComputerPlayer::get_search_stats() const {
+  return search_stats;
+}
+
+void ComputerPlayer::set_pruning(bool enabled) { pruning = enabled; }
+
+void ComputerPlayer::set_opening_book(shared_ptr<const OpeningBook> book) {
+  opening_book = book;
+}
+
+void ComputerPlayer::set_position_cache(shared_ptr<PositionCache> cache) {
+  position_cache = cache;
+}
+
+void ComputerPlayer::set_lexicon_filter(bool enabled) {
+  lexicon_filter = enabled;
+}
+
+void ComputerPlayer::set_move_cache(bool enabled) {
+  move_cache_enabled = enabled;
+  move_cache.clear();
+  line_keys.clear();
+  move_cache_size = 0;
+}
+
+ComputerPlayer::SearchCounters &ComputerPlayer::SearchCounters::operator+=(
+    const SearchCounters &other) {
+  anchors_visited += other.anchors_visited;
+  nodes_expanded += other.nodes_expanded;
+  rack_lookups += other.rack_lookups;
+  candidates_emitted += other.candidates_emitted;
+  candidates_rejected += other.candidates_rejected;
+  words_validated += other.words_validated;
+  cross_word_hits += other.cross_word_hits;
+  generation_time += other.generation_time;
+  scoring_time += other.scoring_time;
+  arena_allocations += other.arena_allocations;
+  arena_bytes += other.arena_bytes;
+  arena_heap_blocks += other.arena_heap_blocks;
+  subtrees_cut += other.subtrees_cut;
+  lexicon_marks += other.lexicon_marks;
+  length_cuts += other.length_cuts;
+  return *this;
+}
+
+void ComputerPlayer::set_instrumentation(bool enabled) {
+  instrumentation = enabled;
+}
+
+const ComputerPlayer::SearchCounters &
+ComputerPlayer::get_move_counters() const {
+  return move_counters;
+}
+
+const ComputerPlayer::SearchCounters &
+ComputerPlayer::get_game_counters() const {
+  return game_counters;
+}
+
+void ComputerPlayer::reset_game_counters() {
+  game_counters = SearchCounters();
+}
+
+void ComputerPlayer::set_lookahead(size_t candidates) {
+  lookahead = candidates;
+}
+
+void ComputerPlayer::set_opponent_rack(const vector<TileKind> &rack) {
+  opponent_rack = rack;
+  unseen_tiles.clear();
+}
+
+void ComputerPlayer::set_unseen_tiles(const vector<TileKind> &unseen,
+                                      uint32_t seed) {
+  unseen_tiles = unseen;
+  opponent_rack.clear();
+  random.seed(seed);
+}
+
+void ComputerPlayer::left_part(PackedMove partial_move, size_t step,
+                               size_t limit, PackedRack &remaining_tiles,
+                               pmr::vector<PackedMove> &legal_moves,
+                               SearchContext &ctx) const {
+
+  // the prefix occupies the squares directly before the anchor
+  Board::Position start =
+      ctx.anchor.translate(partial_move.direction, -partial_move.length);
+  partial_move.row = start.row;
+  partial_move.column = start.column;
+
+  // now that the prefix squares are fixed, so are its points
+  PartialScore score;
+  for (size_t i = 0; i < partial_move.length; i++) {
+    score = ctx.place(score, start, ctx.tile_of(partial_move.tiles[i]));
+    start = start.translate(partial_move.direction, 1);
+  }
+
+  // each prefix (including the empty one) is extended through the anchor
+  extend_right(ctx.anchor, partial_move, step, score, remaining_tiles,
+               legal_moves, ctx);
+
+  // base case
+  if (limit == 0 || partial_move.full() || ctx.out_of_time()) {
+    return;
+  }
+
+  if (ctx.counters != nullptr) {
+    ctx.counters->nodes_expanded++;
+  }
+
+  // iterate through all possible prefix combos available in trie
+  // a prefix is built on squares no perpendicular word runs through
+  uint32_t letters = BoardState::ALL_LETTERS;
+  ctx.each_next_tile(step, remaining_tiles, letters, [&](const TileKind &tile) {
+    // sandwich recursion
+    partial_move.push(tile);
+    remaining_tiles.remove_tile(tile);
+    left_part(partial_move, step + 1, limit - 1, remaining_tiles, legal_moves,
+              ctx);
+    remaining_tiles.add_tile(tile);
+    partial_move.pop();
+  });
+}
+
+void ComputerPlayer::extend_right(Board::Position square,
+                                  PackedMove partial_move, size_t step,
+                                  PartialScore score,
+                                  PackedRack &remaining_tiles,
+                                  pmr::vector<PackedMove> &legal_moves,
+                                  SearchContext &ctx) const {
+  if (ctx.out_of_time()) {
+    return;
+  }
+
+  if (ctx.board.in_bounds_and_has_tile(square)) {
+    // tiles already on the board must continue the word
+    if (!ctx.advance(step, ctx.board.letter_at(square))) {
+      return;
+    }
+    score.word_points += ctx.board.square_at(square).get_tile_kind().points;
+    extend_right(square.translate(partial_move.direction, 1), partial_move,
+                 step + 1, score, remaining_tiles, legal_moves, ctx);
+    return;
+  }
+
+  // cut this subtree if no word in it fits before the edge of the board or
+  // has few enough empty squares for the rack
+  size_t tiles_left = remaining_tiles.count_tiles();
+  if (!ctx.fits(square, step, tiles_left)) {
+    if (ctx.counters != nullptr) {
+      ctx.counters->length_cuts++;
+    }
+    return;
+  }
+
+  // cut this subtree if nothing in it can beat the best move so far
+  if (ctx.pruning &&
+      ctx.bound(square, score, remaining_tiles,
+                min(tiles_left, ctx.longest(step))) <= ctx.threshold) {
+    ctx.stats.nodes_pruned++;
+    return;
+  }
+
+  // if the word ends here and covers the anchor, include it!
+  if (square != ctx.anchor && !ctx.across_twin(partial_move)) {
+    ctx.emit(partial_move, step, legal_moves);
   }
 
   // Base Case: if position is out-of-bounds
-  if (!board.is_in_bounds(square)) {
+  if (!ctx.board.is_in_bounds(square) || partial_move.full()) {
     return;
   }
-  if (board.in_bounds_and_has_tile(square)) {
-    // capture square for word prefix lookup
-    partial_word.push_back(board.letter_at(square));
 
-    // dictionary check
-    shared_ptr<Dictionary::TrieNode> trie_this = d.find_prefix(partial_word);
-    if (trie_this == nullptr)
+  if (ctx.counters != nullptr) {
+    ctx.counters->nodes_expanded++;
+  }
+  Board::Position next = square.translate(partial_move.direction, 1);
+
+  // Check all possible combos, leaving out letters that would not make the
+  // perpendicular word through square a word
+  uint32_t letters = ctx.state.cross_letters_at(square, ctx.direction);
+  ctx.each_next_tile(step, remaining_tiles, letters, [&](const TileKind &tile) {
+    // sandwich R.C. to extend_right
+    partial_move.push(tile);
+    remaining_tiles.remove_tile(tile);
+    extend_right(next, partial_move, step + 1, ctx.place(score, square, tile),
+                 remaining_tiles, legal_moves, ctx);
+    remaining_tiles.add_tile(tile);
+    partial_move.pop();
+  });
+}
+
+void ComputerPlayer::search_anchor(const Board::Anchor &anchor,
+                                   PackedRack &remaining_tiles,
+                                   pmr::vector<PackedMove> &legal_moves,
+                                   SearchContext &ctx) const {
+  ctx.anchor = anchor.position;
+  ctx.direction = anchor.direction;
+  if (ctx.marks != nullptr) {
+    // words through the anchor can only use the letters on its line
+    uint32_t letters = ctx.rack_letters;
+    Board::Position square =
+        anchor.direction == Direction::ACROSS
+            ? Board::Position(anchor.position.row, 0)
+            : Board::Position(0, anchor.position.column);
+    for (; ctx.board.is_in_bounds(square);
+         square = square.translate(anchor.direction)) {
+      size_t kind = ctx.board.in_bounds_and_has_tile(square)
+                        ? PackedRack::index(ctx.board.letter_at(square))
+                        : PackedRack::KINDS;
+      if (kind < PackedRack::BLANK) {
+        letters |= 1u << kind;
+      }
+    }
+    ctx.spell_with(letters);
+  }
+  PackedMove part_move(anchor.position.row, anchor.position.column,
+                       anchor.direction);
+
+  // look for tiles on board opposite place direction and add to prefix
+  Board::Position pos_traverse = anchor.position.translate(anchor.direction, -1);
+  bool board_prefix = ctx.board.in_bounds_and_has_tile(pos_traverse);
+  Trace::Span span(board_prefix ? "extend_right" : "left_part");
+  span.arg("row", anchor.position.row);
+  span.arg("column", anchor.position.column);
+  span.arg("down", anchor.direction == Direction::DOWN);
+  if (!board_prefix) {
+    // call left for where prefixes may be built
+    ctx.branches[0].assign(1, {ctx.dictionary.get_root().get(), 0, '\0'});
+    left_part(part_move, 0, anchor.limit, remaining_tiles, legal_moves, ctx);
+    return;
+  }
+
+  // the board tiles before the anchor, walked back to front
+  while (ctx.board.in_bounds_and_has_tile(pos_traverse)) {
+    pos_traverse = pos_traverse.translate(anchor.direction, -1);
+  }
+  const Dictionary::TrieNode *node = ctx.dictionary.get_root().get();
+  PartialScore score;
+  for (pos_traverse = pos_traverse.translate(anchor.direction, 1);
+       pos_traverse != anchor.position;
+       pos_traverse = pos_traverse.translate(anchor.direction, 1)) {
+    map<char, shared_ptr<Dictionary::TrieNode>>::const_iterator it =
+        node->nexts.find(ctx.board.letter_at(pos_traverse));
+    if (it == node->nexts.end()) {
       return;
+    }
+    node = it->second.get();
+    score.word_points += ctx.board.square_at(pos_traverse).get_tile_kind().points;
+  }
 
-    // advance square for R.C.
-    square.translate(partial_move.direction, 1);
-    extend_right(square, partial_word, partial_move, trie_this, remaining_tiles,
-                 legal_moves, board, d);
-  } else {
-    bool has_blank = false;
-    try {
-      TileKind blank = remaining_tiles.lookup_tile('?');
-      has_blank = true;
-    } catch (out_of_range &oor) {
-    }
-    // Check all possible combos
-    map<char, shared_ptr<Dictionary::TrieNode>>::iterator it =
-        node->nexts.begin();
-    for (; it != node->nexts.end(); it++) {
-      try {
-        // Call for blank tile
-        if (has_blank) {
-          TileKind tk2 = remaining_tiles.lookup_tile('?');
-
-          // update word w/ tile from hand/trie
-          string temp_string(partial_word);
-          temp_string.push_back(it->first);
-
-          // build trie and verify, string is word
-          shared_ptr<Dictionary::TrieNode> trie_this =
-              d.find_prefix(temp_string);
-          if (trie_this == nullptr)
-            return;
-
-          // update blank assigned
-          tk2.assigned = it->first;
-          partial_move.tiles.push_back(tk2);
-
-          // sandwich R.C. to extend_right
-          remaining_tiles.remove_tile(tk2);
-          extend_right(square, temp_string, partial_move, trie_this,
-                       remaining_tiles, legal_moves, board, d);
-          tk2.assigned = '\0';
-          remaining_tiles.add_tile(tk2);
-
-          // backstep
-          temp_string.pop_back();
-          partial_move.tiles.pop_back();
-        }
-        // build call with non-blank tile to extend right
-        TileKind tk = remaining_tiles.lookup_tile(it->first);
+  // call right w/ all letters prior to place considered
+  ctx.branches[0].assign(1, {node, 0, '\0'});
+  extend_right(anchor.position, part_move, 0, score, remaining_tiles,
+               legal_moves, ctx);
+}
+
+unsigned int ComputerPlayer::anchor_bound(const Board::Anchor &anchor,
+                                          SearchContext &ctx) const {
+  size_t tile_count = ctx.rack.count_tiles();
+  if (tile_count == 0) {
+    return 0;
+  }
+  ctx.direction = anchor.direction;
+
+  // board tiles directly before the anchor are part of every word through it
+  PartialScore prefix;
+  Board::Position cursor = anchor.position.translate(anchor.direction, -1);
+  bool board_prefix = ctx.board.in_bounds_and_has_tile(cursor);
+  while (ctx.board.in_bounds_and_has_tile(cursor)) {
+    prefix.word_points += ctx.board.square_at(cursor).get_tile_kind().points;
+    cursor = cursor.translate(anchor.direction, -1);
+  }
 
-        // update word w/ tile from hand/trie
-        string temp_string(partial_word);
-        temp_string.push_back(it->first);
+  // otherwise a prefix could start up to limit squares before the anchor,
+  // leaving at least one tile for the anchor itself
+  size_t reach_left = board_prefix ? 0 : min(anchor.limit, tile_count - 1);
+  Board::Position start =
+      anchor.position.translate(anchor.direction, -reach_left);
+  return ctx.bound(start, prefix, ctx.packed_rack, reach_left + tile_count);
+}
 
-        // build trie and verify, string is word
-        shared_ptr<Dictionary::TrieNode> trie_this = d.find_prefix(temp_string);
-        if (trie_this == nullptr)
-          return;
+// Returns the rack tiles spelling word, leaving out the letter at board_index
+// (if any) since a board tile already has it, or an empty move if the rack
+// cannot spell it. Letters in the rack are used before blanks.
+static PackedMove bingo_tiles(const PackedRack &rack, const string &word,
+                              size_t board_index, Board::Position start,
+                              Direction direction) {
+  PackedMove move(start.row, start.column, direction);
+  PackedRack remaining = rack;
+  for (size_t i = 0; i < word.size(); i++) {
+    if (i == board_index) {
+      continue;
+    }
+    char letter = word[i];
+    if (remaining.has(letter)) {
+      TileKind tile = remaining.lookup_tile(letter);
+      remaining.remove_tile(tile);
+      move.push(tile);
+    } else if (remaining.has(TileKind::BLANK_LETTER)) {
+      TileKind tile = remaining.lookup_tile(TileKind::BLANK_LETTER);
+      remaining.remove_tile(tile);
+      tile.assigned = letter;
+      move.push(tile);
+    } else {
+      return PackedMove(start.row, start.column, direction);
+    }
+  }
+  return move;
+}
 
-        // update move object
-        partial_move.tiles.push_back(tk);
-        square.translate(partial_move.direction, 1);
+unsigned int ComputerPlayer::bingo_bound(SearchContext &ctx, size_t n,
+                                         vector<RankedMove> &bingos) const {
+  const Board &board = ctx.board;
+  const PackedRack &rack = ctx.packed_rack;
+  if (rack.count_tiles() != ctx.hand_size) {
+    return 0;
+  }
+  Trace::Span span("bingo_bound");
 
-        // sandwich R.C. to extend_right
-        remaining_tiles.remove_tile(tk);
-        extend_right(square, temp_string, partial_move, trie_this,
-                     remaining_tiles, legal_moves, board, d);
-        remaining_tiles.add_tile(tk);
+  string letters;
+  for (char letter = 'a'; letter <= 'z'; letter++) {
+    letters.append(rack.counts[PackedRack::slot(letter)], letter);
+  }
+  size_t blanks = rack.counts[PackedRack::BLANK];
 
-        // backstep
-        temp_string.pop_back();
-        partial_move.tiles.pop_back();
+  // the squares a move must cover to touch the tiles already placed, per
+  // direction
+  vector<bool> anchor_squares(board.rows * board.columns * 2, false);
+  for (const Board::Anchor &anchor : ctx.state.anchors()) {
+    size_t down = anchor.direction == Direction::DOWN;
+    anchor_squares[(anchor.position.row * board.columns +
+                    anchor.position.column) * 2 + down] = true;
+  }
 
-      } catch (out_of_range &oor) {
+  // Every placement found, keyed by its squares and tiles with the letters
+  // of its blanks left out, so that placements differing only in those can
+  // be scored as alternatives.
+  vector<pair<string, PackedMove>> placements;
+  auto fit = [&](const string &word, Board::Position start,
+                 Direction direction, size_t board_index) {
+    size_t down = direction == Direction::DOWN;
+    if (!board.is_in_bounds(start.translate(direction, word.size() - 1)) ||
+        board.in_bounds_and_has_tile(start.translate(direction, -1)) ||
+        board.in_bounds_and_has_tile(start.translate(direction, word.size()))) {
+      return;
+    }
+    bool touches = board_index < word.size();
+    for (size_t i = 0; i < word.size(); i++) {
+      Board::Position square = start.translate(direction, i);
+      if (board.in_bounds_and_has_tile(square) != (i == board_index)) {
+        return;
+      }
+      touches = touches ||
+                anchor_squares[(square.row * board.columns + square.column) *
+                                   2 + down];
+    }
+    if (!touches) {
+      return;
+    }
+    Board::Position first =
+        board_index == 0 ? start.translate(direction, 1) : start;
+    PackedMove move = bingo_tiles(rack, word, board_index, first, direction);
+    if (move.length == 0) {
+      return;
+    }
+    string key = {static_cast<char>(move.row), static_cast<char>(move.column),
+                  static_cast<char>(down)};
+    for (size_t i = 0; i < move.length; i++) {
+      key += static_cast<char>(move.tiles[i] & PackedMove::BLANK_FLAG
+                                   ? PackedMove::BLANK_FLAG
+                                   : move.tiles[i]);
+    }
+    placements.push_back({key, move});
+  };
+  const Direction directions[] = {Direction::ACROSS, Direction::DOWN};
+  // once out of time, the placements already fitted are enough to score
+  auto out_of_time = [&]() {
+    if (placements.empty() || chrono::steady_clock::now() < ctx.deadline) {
+      return false;
+    }
+    ctx.timed_out = true;
+    return true;
+  };
+
+  // the rack alone, anywhere it fits
+  for (const string &word : ctx.dictionary.find_anagrams(letters, blanks)) {
+    if (out_of_time()) {
+      break;
+    }
+    for (Direction direction : directions) {
+      for (size_t row = 0; row < board.rows; row++) {
+        for (size_t column = 0; column < board.columns; column++) {
+          fit(word, Board::Position(row, column), direction, word.size());
+        }
+      }
+    }
+  }
+
+  // the rack and one board tile, looked up once per letter on the board
+  vector<string> words_with[PackedRack::BLANK];
+  bool looked_up[PackedRack::BLANK] = {};
+  for (size_t row = 0; row < board.rows && !ctx.timed_out; row++) {
+    for (size_t column = 0; column < board.columns; column++) {
+      Board::Position square(row, column);
+      if (!board.in_bounds_and_has_tile(square)) {
         continue;
-      } catch (exception &e) {
+      }
+      if (out_of_time()) {
+        break;
+      }
+      char board_letter = board.letter_at(square);
+      size_t kind = PackedRack::index(board_letter);
+      if (kind >= PackedRack::BLANK) {
         continue;
       }
+      if (!looked_up[kind]) {
+        words_with[kind] =
+            ctx.dictionary.find_anagrams(letters + board_letter, blanks);
+        looked_up[kind] = true;
+      }
+      for (const string &word : words_with[kind]) {
+        for (size_t i = 0; i < word.size(); i++) {
+          if (word[i] != board_letter) {
+            continue;
+          }
+          for (Direction direction : directions) {
+            fit(word, square.translate(direction, -i), direction, i);
+          }
+        }
+      }
     }
-    // clear out tiles vector for next combo
-    partial_move.tiles.clear();
   }
+
+  stable_sort(placements.begin(), placements.end(),
+              [](const pair<string, PackedMove> &lhs,
+                 const pair<string, PackedMove> &rhs) {
+                return lhs.first < rhs.first;
+              });
+  pmr::vector<PackedMove> candidates(&turn_arena);
+  for (size_t i = 0; i < placements.size(); i++) {
+    candidates.push_back(placements[i].second);
+    candidates.back().alternative =
+        i > 0 && placements[i].first == placements[i - 1].first;
+  }
+  get_best_move(candidates, ctx, bingos);
+  ctx.stats.bingos_found = bingos.size();
+  span.arg("bingos", bingos.size());
+  if (bingos.size() < n) {
+    return 0;
+  }
+
+  vector<unsigned int> points;
+  for (const RankedMove &bingo : bingos) {
+    points.push_back(bingo.points);
+  }
+  nth_element(points.begin(), points.begin() + (n - 1), points.end(),
+              greater<unsigned int>());
+  return points[n - 1] - 1;
+}
+
+// orders kept moves by points, then by the order they were found in
+static bool better_ranked(const pair<RankedMove, size_t> &lhs,
+                          const pair<RankedMove, size_t> &rhs) {
+  return lhs.first.points > rhs.first.points ||
+         (lhs.first.points == rhs.first.points && lhs.second < rhs.second);
+}
+
+unsigned int ComputerPlayer::TopMoves::threshold() const {
+  if (heap.size() < capacity) {
+    return 0;
+  }
+  // a move tying a provisional one is found first, so it is kept instead
+  const pair<RankedMove, size_t> &weakest = heap.front();
+  return weakest.first.points - (weakest.second >= PROVISIONAL ? 1 : 0);
+}
+
+// Returns whether lhs and rhs place the same tiles on the same squares.
+static bool same_placement(const Move &lhs, const Move &rhs) {
+  if (lhs.row != rhs.row || lhs.column != rhs.column ||
+      lhs.direction != rhs.direction || lhs.tiles.size() != rhs.tiles.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.tiles.size(); i++) {
+    if (lhs.tiles[i].letter != rhs.tiles[i].letter ||
+        lhs.tiles[i].assigned != rhs.tiles[i].assigned) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ComputerPlayer::TopMoves::add(const RankedMove &move, bool provisional) {
+  size_t order = provisional ? PROVISIONAL + offered++ : offered++;
+  // the bingos kept provisionally are found again through the anchors, and
+  // then ranked as found there
+  for (pair<RankedMove, size_t> &kept : heap) {
+    if (kept.first.points == move.points &&
+        same_placement(kept.first.move, move.move)) {
+      if (kept.second >= PROVISIONAL && !provisional) {
+        kept.second = order;
+        make_heap(heap.begin(), heap.end(), better_ranked);
+      }
+      return;
+    }
+  }
+  if (heap.size() == capacity) {
+    // evict the weakest kept move
+    pop_heap(heap.begin(), heap.end(), better_ranked);
+    heap.pop_back();
+  }
+  heap.push_back({move, order});
+  push_heap(heap.begin(), heap.end(), better_ranked);
+}
+
+vector<RankedMove> ComputerPlayer::TopMoves::sorted() const {
+  vector<pair<RankedMove, size_t>> ranked = heap;
+  sort(ranked.begin(), ranked.end(), better_ranked);
+
+  vector<RankedMove> moves;
+  for (size_t i = 0; i < ranked.size(); i++) {
+    moves.push_back(ranked[i].first);
+  }
+  return moves;
 }
 
 Move ComputerPlayer::get_move(const Board &board,
                               const Dictionary &dictionary) const {
-  vector<Move> legal_moves;
-  vector<Board::Anchor> anchors = board.get_anchors();
-  vector<TileKind> temp_tiles;
-  TileCollection tiles_copy = tiles;
-
-  // computer makes first move
-  if (!board.in_bounds_and_has_tile(board.start)) {
-    shared_ptr<Dictionary::TrieNode> trie_this = dictionary.find_prefix("");
-    Move part_move = Move(temp_tiles, anchors[0].position.row,
-                          anchors[0].position.column, anchors[0].direction);
-    extend_right(board.start, "", part_move, trie_this, tiles_copy, legal_moves,
-                 board, dictionary);
+  Trace::Span span("ComputerPlayer::get_move");
+  Move book_move;
+  if (get_book_move(board, dictionary, book_move)) {
+    return book_move;
+  }
+  if (lookahead > 0) {
+    search_stats = SearchStats();
+    move_counters = SearchCounters();
+    Move move = get_lookahead_move(board, dictionary);
+    game_counters += move_counters;
+    return move;
+  }
+  vector<RankedMove> best = get_top_moves(board, dictionary, 1);
+  if (best.empty()) {
+    return Move(); // Pass if no move found
+  }
+  return best[0].move;
+}
 
-  } else {
-    // Search through all anchors, building all legal word combos to pass for
-    // get_best_move
+// Returns everything the moves found for a position depend on: every square
+// with its multipliers or tile, the rack, the hand size (for the empty hand
+// bonus), the dictionary and how many moves are asked for.
+static string position_key(const Board &board, const Dictionary &dictionary,
+                           const TileCollection &rack, size_t hand_size,
+                           size_t n) {
+  string key;
+  auto append = [&key](uint64_t value) {
+    key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  };
+  append(dictionary.get_hash());
+  append(hand_size);
+  append(n);
+  append(board.rows);
+  append(board.columns);
+  append(board.start.row);
+  append(board.start.column);
+  for (size_t row = 0; row < board.rows; row++) {
+    for (size_t column = 0; column < board.columns; column++) {
+      const BoardSquare &square = board.square_at(Board::Position(row, column));
+      key += static_cast<char>(square.letter_multiplier);
+      key += static_cast<char>(square.word_multiplier);
+      if (square.has_tile()) {
+        TileKind tile = square.get_tile_kind();
+        key += tile.letter;
+        key += tile.assigned;
+        key += static_cast<char>(tile.points);
+      } else {
+        key += '\0';
+      }
+    }
+  }
+  // get_tiles lists the rack in sorted order
+  for (const TileKind &tile : rack.get_tiles()) {
+    key += tile.letter;
+    key += static_cast<char>(tile.points);
+  }
+  return key;
+}
+
+vector<RankedMove> ComputerPlayer::get_top_moves(const Board &board,
+                                                 const Dictionary &dictionary,
+                                                 size_t n) const {
+  chrono::steady_clock::time_point deadline =
+      chrono::steady_clock::time_point::max();
+  if (time_budget.count() > 0) {
+    deadline = chrono::steady_clock::now() + time_budget;
+  }
+  search_stats = SearchStats();
+  move_counters = SearchCounters();
+
+  vector<RankedMove> top;
+  string key;
+  if (position_cache != nullptr) {
+    key = position_key(board, dictionary, tiles, get_hand_size(), n);
+    if (position_cache->find(key, top)) {
+      search_stats.position_hits++;
+      return top;
+    }
+  }
+
+  top = search(board, dictionary, BoardState(board, dictionary), tiles, n,
+               deadline);
+  game_counters += move_counters;
+  // a search cut short may have missed the best moves
+  if (position_cache != nullptr && chrono::steady_clock::now() < deadline) {
+    position_cache->insert(key, top);
+  }
+  return top;
+}
+
+vector<RankedMove>
+ComputerPlayer::search(const Board &board, const Dictionary &dictionary,
+                       const BoardState &state, const TileCollection &rack,
+                       size_t n,
+                       chrono::steady_clock::time_point deadline) const {
+  if (n == 0) {
+    return vector<RankedMove>();
+  }
+  SearchContext ctx(board, dictionary, state, rack, get_hand_size(),
+                    search_stats);
+  ctx.deadline = deadline;
+  ctx.pruning = pruning;
+  if (instrumentation) {
+    ctx.counters = &move_counters;
+  }
+  // declared before anything allocated from the arena, so that it is
+  // released after all of it is gone
+  ArenaRelease release{turn_arena, ctx.counters};
+  // the same perpendicular words are formed by candidate after candidate
+  pmr::unordered_map<pmr::string, bool> cross_words(&turn_arena);
+  ctx.cross_words = &cross_words;
+
+  // a blank can spell anything, so the lexicon filter would cut nothing
+  if (lexicon_filter && !ctx.packed_rack.has(TileKind::BLANK_LETTER)) {
+    for (char letter = 'a'; letter <= 'z'; letter++) {
+      if (ctx.packed_rack.has(letter)) {
+        ctx.rack_letters |= 1u << (letter - 'a');
+      }
+    }
+    // only the nodes marked by the last search need to be unmarked
+    if (lexicon_marks.size() != dictionary.get_node_count()) {
+      lexicon_marks.assign(dictionary.get_node_count(),
+                           SearchContext::UNMARKED);
+    } else {
+      for (uint32_t id : lexicon_marked) {
+        lexicon_marks[id] = SearchContext::UNMARKED;
+      }
+    }
+    lexicon_marked.clear();
+    ctx.marks = &lexicon_marks;
+    ctx.marked = &lexicon_marked;
+  }
+
+  // search the anchors that could score the most first, so that the best move
+  // found so far is a good one when the budget runs out
+  vector<Board::Anchor> anchors = state.anchors();
+  pmr::vector<pair<unsigned int, size_t>> order(&turn_arena);
+  {
+    Trace::Span span("get_anchors");
+    span.arg("anchors", anchors.size());
     for (size_t i = 0; i < anchors.size(); i++) {
+      order.push_back({anchor_bound(anchors[i], ctx), i});
+    }
+    stable_sort(order.begin(), order.end(),
+                [](const pair<unsigned int, size_t> &lhs,
+                   const pair<unsigned int, size_t> &rhs) {
+                  return lhs.first > rhs.first;
+                });
+  }
 
-      bool end_search = false;
-
-      // position will shift in search
-      Board::Position pos_traverse = anchors[i].position;
-      Direction dir_traverse = anchors[i].direction;
-
-      // position will be passed to move object for left/right calls
-      Board::Position move_pos = pos_traverse;
-      Move part_move =
-          Move(temp_tiles, pos_traverse.row, pos_traverse.column, dir_traverse);
-
-      // if limit is 0, no call to left part, but requires checking for existing
-      // prefix to call extend_right
-      if (anchors[i].limit == 0) {
-
-        // look for tiles on board opposite place direction and add to prefix
-        string prefix = "";
-        while (!end_search) {
-          if (board.in_bounds_and_has_tile(pos_traverse)) {
-            prefix.push_back(board.letter_at(pos_traverse));
-            pos_traverse.translate(dir_traverse, -1);
-          } else {
-            end_search = true;
-          }
-        }
-        // call right w/ all letters prior to place considered
-        shared_ptr<Dictionary::TrieNode> trie_this =
-            dictionary.find_prefix(prefix);
-        extend_right(anchors[i].position, prefix, part_move, trie_this,
-                     tiles_copy, legal_moves, board, dictionary);
-      }
-      // call left for where prefixes may be built
-      else if (anchors[i].limit > 0) {
-
-        // look for tiles on board in the place direction and add to prefix
-        string prefix = "";
-        while (!end_search) {
-          if (board.in_bounds_and_has_tile(pos_traverse)) {
-            prefix.push_back(board.letter_at(pos_traverse));
-            pos_traverse.translate(dir_traverse, 1);
-          } else {
-            end_search = true;
+  // a search already out of time is not worth bringing the cache up to date
+  bool use_cache =
+      move_cache_enabled && chrono::steady_clock::now() < ctx.deadline;
+  string rack_key;
+  if (use_cache) {
+    refresh_move_cache(board, dictionary);
+    for (const TileKind &tile : rack.get_tiles()) {
+      rack_key += tile.letter;
+      rack_key += static_cast<char>(tile.points);
+    }
+  }
+
+  PackedRack tiles_copy = ctx.packed_rack;
+  pmr::vector<PackedMove> legal_moves(&turn_arena);
+  vector<RankedMove> scored;
+  TopMoves top(n);
+
+  // bingos found up front are kept, and let the search cut every move they
+  // beat
+  unsigned int floor = 0;
+  if (ctx.pruning) {
+    vector<RankedMove> bingos;
+    floor = bingo_bound(ctx, n, bingos);
+    for (const RankedMove &bingo : bingos) {
+      if (bingo.points > top.threshold()) {
+        top.add(bingo, true);
+      }
+    }
+  }
+  ctx.threshold = floor;
+
+  for (size_t i = 0; i < order.size(); i++) {
+    if (ctx.has_move && chrono::steady_clock::now() >= ctx.deadline) {
+      ctx.timed_out = true;
+      break;
+    }
+    // no anchor from here on can beat the moves already kept
+    if (ctx.pruning && order[i].first <= ctx.threshold) {
+      search_stats.anchors_pruned += order.size() - i;
+      break;
+    }
+    const Board::Anchor &anchor = anchors[order[i].second];
+
+    // cached moves can be used if they were kept against a threshold no higher
+    // than the current one: any move they leave out could not be kept now
+    unordered_map<string, CachedAnchor> *line_cache = nullptr;
+    string key;
+    if (use_cache) {
+      bool down = anchor.direction == Direction::DOWN;
+      size_t line = down ? board.rows + anchor.position.column
+                         : anchor.position.row;
+      line_cache = &move_cache[line];
+      key = rack_key;
+      key += static_cast<char>(down ? anchor.position.row
+                                    : anchor.position.column);
+      key += static_cast<char>(anchor.limit);
+      key += line_keys[line];
+
+      auto cached = line_cache->find(key);
+      if (cached != line_cache->end() &&
+          cached->second.threshold <= ctx.threshold) {
+        search_stats.cache_hits++;
+        for (const RankedMove &move : cached->second.moves) {
+          if (move.points > top.threshold()) {
+            top.add(move);
+            ctx.has_move = true;
           }
         }
-        // Move position will change with limit
-        if (anchors[i].direction == Direction::ACROSS) {
-          part_move =
-              Move(temp_tiles, anchors[i].position.row,
-                   anchors[i].position.column - anchors[i].limit, dir_traverse);
-        } else {
-          part_move =
-              Move(temp_tiles, anchors[i].position.row - anchors[i].limit,
-                   anchors[i].position.column, dir_traverse);
+        ctx.threshold = max(top.threshold(), floor);
+        continue;
+      }
+    }
+
+    legal_moves.clear();
+    scored.clear();
+    if (ctx.counters == nullptr) {
+      search_anchor(anchor, tiles_copy, legal_moves, ctx);
+      get_best_move(legal_moves, ctx, scored);
+    } else {
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      search_anchor(anchor, tiles_copy, legal_moves, ctx);
+      chrono::steady_clock::time_point generated = chrono::steady_clock::now();
+      get_best_move(legal_moves, ctx, scored);
+      ctx.counters->anchors_visited++;
+      ctx.counters->generation_time += generated - start;
+      ctx.counters->scoring_time += chrono::steady_clock::now() - generated;
+    }
+    for (const RankedMove &move : scored) {
+      if (move.points > top.threshold()) {
+        top.add(move);
+      }
+    }
+
+    // an anchor cut short by the deadline may be missing moves
+    if (line_cache != nullptr && !ctx.timed_out) {
+      search_stats.cache_misses++;
+      if (move_cache_size >= MOVE_CACHE_CAPACITY) {
+        for (unordered_map<string, CachedAnchor> &entries : move_cache) {
+          entries.clear();
         }
-        shared_ptr<Dictionary::TrieNode> trie_this = dictionary.get_root();
-        left_part(anchors[i].position, prefix, part_move, trie_this,
-                  anchors[i].limit, tiles_copy, legal_moves, board, dictionary);
+        move_cache_size = 0;
       }
+      auto inserted = line_cache->insert({key, CachedAnchor()});
+      if (inserted.second) {
+        move_cache_size++;
+      }
+      inserted.first->second.threshold = ctx.threshold;
+      inserted.first->second.moves = scored;
+    }
+    ctx.threshold = max(top.threshold(), floor);
+  }
+  if (ctx.timed_out) {
+    search_stats.timed_out = true;
+  }
+  return top.sorted();
+}
+
+// Returns the key of one row (ACROSS) or column (DOWN): every board tile and
+// its points, every multiplier, and for every empty square the tiles of the
+// perpendicular word it would join.
+static string line_key(const Board &board, Direction direction, size_t line) {
+  size_t length = direction == Direction::ACROSS ? board.columns : board.rows;
+  string key;
+  for (size_t i = 0; i < length; i++) {
+    Board::Position square = direction == Direction::ACROSS
+                                 ? Board::Position(line, i)
+                                 : Board::Position(i, line);
+    const BoardSquare &board_square = board.square_at(square);
+    if (board_square.has_tile()) {
+      key += board.letter_at(square);
+      key += static_cast<char>(board_square.get_tile_kind().points);
+      continue;
+    }
+    key += static_cast<char>(board_square.letter_multiplier);
+    key += static_cast<char>(board_square.word_multiplier);
+
+    Board::Position cursor = square.translate(!direction, -1);
+    while (board.in_bounds_and_has_tile(cursor)) {
+      cursor = cursor.translate(!direction, -1);
+    }
+    for (cursor = cursor.translate(!direction, 1); cursor != square;
+         cursor = cursor.translate(!direction, 1)) {
+      key += board.letter_at(cursor);
+      key += static_cast<char>(board.square_at(cursor).get_tile_kind().points);
+    }
+    key += '_';
+    for (cursor = square.translate(!direction, 1);
+         board.in_bounds_and_has_tile(cursor);
+         cursor = cursor.translate(!direction, 1)) {
+      key += board.letter_at(cursor);
+      key += static_cast<char>(board.square_at(cursor).get_tile_kind().points);
+    }
+    key += '|';
+  }
+  return key;
+}
+
+void ComputerPlayer::refresh_move_cache(const Board &board,
+                                        const Dictionary &dictionary) const {
+  size_t lines = board.rows + board.columns;
+  // keyed by the words, not the address: another dictionary can be read
+  // into the same place
+  if (cache_dictionary_hash != dictionary.get_hash() ||
+      move_cache.size() != lines) {
+    move_cache.assign(lines, unordered_map<string, CachedAnchor>());
+    line_keys.assign(lines, string());
+    move_cache_size = 0;
+    cache_dictionary_hash = dictionary.get_hash();
+  }
+
+  for (size_t line = 0; line < lines; line++) {
+    string key = line < board.rows
+                     ? line_key(board, Direction::ACROSS, line)
+                     : line_key(board, Direction::DOWN, line - board.rows);
+    if (key != line_keys[line]) {
+      move_cache_size -= move_cache[line].size();
+      move_cache[line].clear();
+      line_keys[line] = key;
     }
   }
-  return get_best_move(legal_moves, board, dictionary);
 }
 
-Move ComputerPlayer::get_best_move(vector<Move> legal_moves, const Board &board,
-                                   const Dictionary &dictionary) const {
-  Move best_move = Move(); // Pass if no move found
-  // HW5: IMPLEMENT THIS
-  if (legal_moves.empty()) {
-    return best_move;
+bool ComputerPlayer::get_book_move(const Board &board,
+                                   const Dictionary &dictionary,
+                                   Move &move) const {
+  if (opening_book == nullptr || lookahead > 0 ||
+      board.in_bounds_and_has_tile(board.start) ||
+      !opening_book->matches(board, dictionary)) {
+    return false;
+  }
+  const OpeningBook::Entry *entry =
+      opening_book->find(OpeningBook::rack_key(tiles));
+  if (entry == nullptr) {
+    return false;
+  }
+  search_stats = SearchStats();
+  move_counters = SearchCounters();
+  if (entry->length == 0) {
+    search_stats.book_hits++;
+    move = Move();
+    return true;
+  }
+
+  // the rack must hold the tiles, and placing them must score what the book
+  // says (tile points are not part of the key)
+  PackedRack remaining(tiles);
+  for (size_t i = 0; i < entry->length && i < OpeningBook::MAX_TILES; i++) {
+    char letter = entry->tiles[i] & PackedMove::BLANK_FLAG
+                      ? TileKind::BLANK_LETTER
+                      : static_cast<char>(entry->tiles[i]);
+    if (!remaining.has(letter)) {
+      return false;
+    }
+    remaining.remove_tile(remaining.lookup_tile(letter));
+  }
+  OpeningBook::unpack(*entry, tiles, move);
+  PlaceResult result = board.test_place(move);
+  unsigned int points = result.points;
+  if (move.tiles.size() == get_hand_size()) {
+    points += Scrabble::EMPTY_HAND_BONUS;
   }
+  if (!result.valid || points != entry->points) {
+    return false;
+  }
+  search_stats.book_hits++;
+  return true;
+}
+
+Move ComputerPlayer::get_lookahead_move(const Board &board,
+                                        const Dictionary &dictionary) const {
+  chrono::steady_clock::time_point deadline =
+      chrono::steady_clock::time_point::max();
+  if (time_budget.count() > 0) {
+    deadline = chrono::steady_clock::now() + time_budget;
+  }
+
+  BoardState state(board, dictionary);
+  vector<RankedMove> candidates =
+      search(board, dictionary, state, tiles, lookahead, deadline);
+  if (candidates.empty()) {
+    return Move(); // Pass if no move found
+  }
+
+  // the opponent's hand, assumed or sampled from the unseen tiles
+  TileCollection opponent;
+  if (!unseen_tiles.empty()) {
+    vector<TileKind> pool = unseen_tiles;
+    shuffle(pool.begin(), pool.end(), random);
+    for (size_t i = 0; i < pool.size() && i < get_hand_size(); i++) {
+      opponent.add_tile(pool[i]);
+    }
+  } else {
+    for (const TileKind &tile : opponent_rack) {
+      opponent.add_tile(tile);
+    }
+  }
+
+  // one scratch board for every candidate: each is made, answered and undone
+  Board scratch = board;
+  size_t best_idx = 0;
+  long best_spread = 0;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+    Board::TrialMove trial(scratch, candidates[i].move);
+    state.refresh(scratch, trial.placed());
+
+    vector<RankedMove> reply =
+        search(scratch, dictionary, state, opponent, 1, deadline);
+    long spread = static_cast<long>(candidates[i].points) -
+                  (reply.empty() ? 0 : static_cast<long>(reply[0].points));
 
-  // base place result
-  vector<string> words;
-  PlaceResult best_place(words, 0);
-  size_t best_idx;
+    trial.undo();
+    state.refresh(scratch, trial.placed());
 
-  // consider all legal_moves
+    // ties keep the higher scoring candidate
+    if (i == 0 || spread > best_spread) {
+      best_spread = spread;
+      best_idx = i;
+    }
+  }
+  return candidates[best_idx].move;
+}
+
+void ComputerPlayer::get_best_move(const pmr::vector<PackedMove> &legal_moves,
+                                   SearchContext &ctx,
+                                   vector<RankedMove> &scored) const {
+  Trace::Span span("get_best_move");
+  span.arg("candidates", legal_moves.size());
+  // consider all legal_moves, each unpacked into the same Move and checked
+  // into the same word list, which lives in the turn arena
+  Move move;
+  pmr::vector<pmr::string> words(&turn_arena);
+  // the words still to look up; every placed tile forms at most one
+  // perpendicular word, and there is the main word
+  pmr::vector<string_view> unchecked(&turn_arena);
+  bool checked[PackedMove::MAX_TILES + 1];
+  // Alternatives differ only in what their blanks stand for. A blank scores
+  // its own points whatever it stands for, so they all score the same and are
+  // placed or rejected the same way: once one is kept, or the placement is
+  // ruled out, the rest are skipped.
+  bool settled = false;
   for (size_t i = 0; i < legal_moves.size(); i++) {
+    if (ctx.out_of_time()) {
+      break;
+    }
+    if (legal_moves[i].alternative && settled) {
+      continue;
+    }
+    settled = true;
+    legal_moves[i].unpack(ctx.rack, move);
 
     // use test_place to verify move is legal and gather its return points for
     // comparison
-    PlaceResult temp_place = board.test_place(legal_moves[i]);
-    try {
-      if (!temp_place.valid) {
-        continue;
+    unsigned int points;
+    if (ctx.board.test_place(move, words, points) != nullptr) {
+      if (ctx.counters != nullptr) {
+        ctx.counters->candidates_rejected++;
       }
+      continue;
+    }
 
-      // dictionary check on all words/subwords from place
-      for (size_t i = 0; i < temp_place.words.size(); i++) {
-        if (!dictionary.is_word(temp_place.words[i])) {
-          throw MoveException("Word not in dictionary :/");
+    // only a move worth more than the threshold can be kept
+    if (move.tiles.size() == ctx.hand_size) {
+      points += Scrabble::EMPTY_HAND_BONUS;
+    }
+    if (points <= ctx.threshold) {
+      continue;
+    }
+
+    // dictionary check on all words/subwords from place: the main word comes
+    // last, and the perpendicular words before it may have been checked for
+    // an earlier candidate
+    bool all_words = true;
+    unchecked.clear();
+    for (size_t j = 0; j < words.size() && all_words; j++) {
+      if (ctx.cross_words != nullptr && j + 1 < words.size()) {
+        auto known = ctx.cross_words->find(words[j]);
+        if (known != ctx.cross_words->end()) {
+          all_words = known->second;
+          if (ctx.counters != nullptr) {
+            ctx.counters->cross_word_hits++;
+          }
+          continue;
         }
       }
-
-      // only the highest scoring move will be returned
-      if (temp_place.points > best_place.points) {
-        best_place = temp_place;
-        best_idx = i;
+      unchecked.push_back(words[j]);
+    }
+    if (all_words && !unchecked.empty()) {
+      all_words = ctx.dictionary.check_words(unchecked.data(),
+                                             unchecked.size(), checked);
+      if (ctx.counters != nullptr) {
+        ctx.counters->words_validated += unchecked.size();
       }
-    } catch (MoveException &e) {
+      for (size_t j = 0; ctx.cross_words != nullptr && j < unchecked.size();
+           j++) {
+        if (unchecked[j].data() != words.back().data()) {
+          ctx.cross_words->emplace(unchecked[j], checked[j]);
+        }
+      }
+    }
+    if (!all_words) {
+      // another letter for the blanks may still form words
+      settled = false;
       continue;
     }
-  }
 
-  // error handling
-  if (best_idx > legal_moves.size()) {
-    return best_move;
+    // the tiles left in hand after the move
+    vector<TileKind> leave = ctx.rack.get_tiles();
+    for (const TileKind &tile : move.tiles) {
+      leave.erase(find(leave.begin(), leave.end(), tile));
+    }
+    scored.push_back(RankedMove(
+        move, points, vector<string>(words.begin(), words.end()), leave));
+    ctx.has_move = true;
   }
-
-  // update best move & return
-  best_move = legal_moves[best_idx];
-  return best_move;
 }
@@ -2,7 +2,16 @@
 #define COMPUTER_PLAYER_H
 
 #include "move.h"
+#include "opening_book.h"
+#include "packed_move.h"
 #include "player.h"
+#include "position_cache.h"
+#include "ranked_move.h"
+#include "turn_arena.h"
+#include <chrono>
+#include <memory>
+#include <random>
+#include <unordered_map>
 
 class ComputerPlayer : public Player {
 public:
@@ -11,7 +20,10 @@ public:
   reference) and a size_t hand size.
   */
   ComputerPlayer(const std::string &name, size_t hand_size)
-      : Player(name, hand_size) {}
+      : Player(name, hand_size), time_budget(0), pruning(true), lookahead(0),
+        move_cache_enabled(true), move_cache_size(0),
+        cache_dictionary_hash(0), lexicon_filter(true),
+        instrumentation(false) {}
   ~ComputerPlayer(){};
 
   /* HW5: IMPLEMENT THIS
@@ -19,70 +31,543 @@ public:
       https://www.cs.cmu.edu/afs/cs/academic/class/15451-s06/www/lectures/scrabble.pdf
 
   See assignment for more details.
+
+  Anchors are searched in decreasing order of the most a move through them
+  could score, and the best move found so far is kept after each anchor. If a
+  time budget is set, the search stops once it expires and returns that move.
+  If lookahead is enabled, the move is chosen by a two-ply search instead.
   */
   Move
   get_move(const Board &board,
            const Dictionary &dictionary) const override; // Used For Testing
 
+  /*
+  Returns up to n of the highest scoring moves for this player's hand, best
+  first, with the points, words and leave of each. get_move returns the first
+  of these. Only the best n are ever kept, so the search costs about the same
+  for any small n.
+  */
+  std::vector<RankedMove> get_top_moves(const Board &board,
+                                        const Dictionary &dictionary,
+                                        size_t n) const;
+
+  /*
+  Sets the wall-clock budget for a single get_move call.
+  A budget of zero (the default) searches every anchor. Once the budget is
+  spent the search stops at its next check and returns the best moves found
+  so far; until it has found a move it keeps going, so that it never passes
+  only for lack of time.
+  */
+  void set_time_budget(std::chrono::milliseconds budget);
+  std::chrono::milliseconds get_time_budget() const;
+
+  /*
+  Enables two-ply search in get_move. Each of the best `candidates` moves is
+  made on the board, the opponent's best reply to it is found, and the move
+  with the most points over its reply is chosen. Zero (the default) disables
+  lookahead.
+  */
+  void set_lookahead(size_t candidates);
+
+  /*
+  The opponent's tiles assumed when searching replies: either exactly `rack`,
+  or a hand sampled from `unseen` (tiles not on the board or in this player's
+  hand) on every get_move call. With neither, replies score nothing.
+  */
+  void set_opponent_rack(const std::vector<TileKind> &rack);
+  void set_unseen_tiles(const std::vector<TileKind> &unseen, uint32_t seed);
+
+  /*
+  Counters from the most recent get_move call.
+
+  anchors_pruned: anchors skipped because no move through them could beat the
+      best move found so far
+  nodes_pruned: partial moves whose extensions were skipped for that reason
+  cache_hits: anchors whose moves were taken from the move cache
+  cache_misses: anchors searched and then stored in the move cache
+  bingos_found: moves using the whole hand found from the anagram index
+      before the search, to start it with a threshold
+  book_hits: opening moves taken from the opening book instead of searched
+  position_hits: positions answered from the position cache
+  timed_out: whether the time budget ran out before the search finished, so
+      the move returned is the best found in time rather than the best
+  */
+  struct SearchStats {
+    size_t anchors_pruned = 0;
+    size_t nodes_pruned = 0;
+    size_t cache_hits = 0;
+    size_t cache_misses = 0;
+    size_t bingos_found = 0;
+    size_t book_hits = 0;
+    size_t position_hits = 0;
+    bool timed_out = false;
+  };
+  const SearchStats &get_search_stats() const;
+
+  /*
+  Enables or disables branch-and-bound pruning (enabled by default).
+  Pruning never changes the move returned, only how much is searched.
+  */
+  void set_pruning(bool enabled);
+
+  /*
+  Enables or disables the move cache (enabled by default). The moves found
+  through an anchor are kept between calls, keyed by the contents of its row
+  or column, the perpendicular words crossing it and the rack, so that only
+  the lines changed since the last search are searched again. Like pruning,
+  it never changes the move returned.
+  */
+  void set_move_cache(bool enabled);
+
+  /*
+  Sets the opening book get_move looks the rack up in while the board's start
+  square is empty (none by default). The book is only used if it was built
+  for the board layout and dictionary played with and has the rack, and the
+  move it has is checked against the board before it is returned. It is
+  not used with lookahead.
+  */
+  void set_opening_book(std::shared_ptr<const OpeningBook> book);
+
+  /*
+  Sets the cache get_move and get_top_moves keep the moves of whole positions
+  in (none by default). The key is the board's squares and tiles, the rack,
+  the hand size, the dictionary and the number of moves asked for. A cache
+  can be shared by players on different threads. Searches cut short by the
+  time budget are not stored, and lookahead does not use the cache.
+  */
+  void set_position_cache(std::shared_ptr<PositionCache> cache);
+
+  /*
+  Enables or disables the lexicon filter (enabled by default). Without a
+  blank in hand, the search through an anchor only enters trie nodes with a
+  word below them that can be spelled from the rack letters and the letters
+  on the anchor's line. Nodes are checked on first use and remembered for as
+  long as the letters stay the same. It never changes the move returned.
+  */
+  void set_lexicon_filter(bool enabled);
+
+  /*
+  Where a search spends its work. Only gathered while instrumentation is
+  enabled; otherwise nothing is counted or timed.
+
+  anchors_visited: anchors searched (not taken from the move cache)
+  nodes_expanded: trie nodes whose children were tried
+  rack_lookups: letters looked up in the remaining tiles
+  candidates_emitted: moves generated for scoring
+  candidates_rejected: generated moves test_place found illegal
+  words_validated: words looked up in the dictionary
+  cross_word_hits: perpendicular words whose check was remembered from an
+      earlier candidate of the same search
+  generation_time: time spent generating moves
+  scoring_time: time spent scoring and validating them
+  arena_allocations: allocations made from the per-search arena rather than
+      the heap
+  arena_bytes: bytes those allocations took
+  arena_heap_blocks: blocks the arena itself had to take from the heap
+  subtrees_cut: trie children skipped by the lexicon filter
+  lexicon_marks: trie nodes the lexicon filter had to check
+  length_cuts: trie children skipped because no word below fits the squares
+      or tiles left
+  */
+  struct SearchCounters {
+    size_t anchors_visited = 0;
+    size_t nodes_expanded = 0;
+    size_t rack_lookups = 0;
+    size_t candidates_emitted = 0;
+    size_t candidates_rejected = 0;
+    size_t words_validated = 0;
+    size_t cross_word_hits = 0;
+    std::chrono::nanoseconds generation_time{0};
+    std::chrono::nanoseconds scoring_time{0};
+    size_t arena_allocations = 0;
+    size_t arena_bytes = 0;
+    size_t arena_heap_blocks = 0;
+    size_t subtrees_cut = 0;
+    size_t lexicon_marks = 0;
+    size_t length_cuts = 0;
+
+    SearchCounters &operator+=(const SearchCounters &other);
+  };
+
+  /*
+  Enables or disables instrumentation (disabled by default). get_move_counters
+  covers the most recent get_move or get_top_moves call, get_game_counters
+  every call since the last reset_game_counters.
+  */
+  void set_instrumentation(bool enabled);
+  const SearchCounters &get_move_counters() const;
+  const SearchCounters &get_game_counters() const;
+  void reset_game_counters();
+
   bool is_human() const { return false; }
 
 private:
-  // The following functions may be modified in any way.
-  // e.g. You may decide you'd prefer to pass in a Dictionary reference rather
-  // than std::shared_ptr<Dictionary::TrieNode>
+  std::chrono::milliseconds time_budget;
+  bool pruning;
+  size_t lookahead;
+  std::vector<TileKind> opponent_rack;
+  std::vector<TileKind> unseen_tiles;
+  mutable std::mt19937 random;
+  mutable SearchStats search_stats;
+
+  /*
+  The scored moves through one anchor, every one worth more than threshold,
+  in the order they were found.
+  */
+  struct CachedAnchor {
+    unsigned int threshold;
+    std::vector<RankedMove> moves;
+  };
+
+  // Move cache, one map per row (ACROSS) then per column (DOWN), and the key
+  // each line had when last searched.
+  bool move_cache_enabled;
+  mutable std::vector<std::unordered_map<std::string, CachedAnchor>> move_cache;
+  mutable std::vector<std::string> line_keys;
+  mutable size_t move_cache_size;
+  // the hash of the word list the cached moves were found with
+  mutable uint64_t cache_dictionary_hash;
+
+  std::shared_ptr<const OpeningBook> opening_book;
+  std::shared_ptr<PositionCache> position_cache;
+
+  // Lexicon filter, what it knows about each trie node and which nodes it
+  // has marked.
+  bool lexicon_filter;
+  mutable std::vector<uint8_t> lexicon_marks;
+  mutable std::vector<uint32_t> lexicon_marked;
+
+  bool instrumentation;
+  mutable SearchCounters move_counters;
+  mutable SearchCounters game_counters;
+
+  // Scratch memory for the candidates of one search, released when it ends.
+  mutable TurnArena turn_arena;
+
+  /*
+  The parts of a board the search reads repeatedly, kept per line so that
+  making or undoing a move only recomputes the lines it touched.
+
+  across: the ACROSS anchors of every row
+  down: the DOWN anchors of every column
+  cross_base: for every square and direction, the points of the board tiles
+      in the perpendicular word through it, or NO_CROSS_WORD
+  cross_letters: for every square and direction, the letters (bit 0 for 'a')
+      a tile placed there can have for the perpendicular word through it to
+      be a word; every letter if there is none
+  */
+  struct BoardState {
+    static constexpr int NO_CROSS_WORD = -1;
+    static constexpr uint32_t ALL_LETTERS = (1u << 26) - 1;
+
+    const Dictionary &dictionary;
+    size_t rows;
+    size_t columns;
+    std::vector<std::vector<Board::Anchor>> across;
+    std::vector<std::vector<Board::Anchor>> down;
+    std::vector<int> cross_base;
+    std::vector<uint32_t> cross_letters;
+
+    BoardState(const Board &board, const Dictionary &dictionary);
+
+    // Brings the state up to date after tiles were placed on or removed from
+    // squares.
+    void refresh(const Board &board,
+                 const std::vector<Board::Position> &squares);
+
+    std::vector<Board::Anchor> anchors() const;
+    int cross_base_at(Board::Position square, Direction direction) const;
+    uint32_t cross_letters_at(Board::Position square,
+                              Direction direction) const;
+
+  private:
+    void refresh_cross_base(const Board &board, Board::Position square);
+  };
+
+  /*
+  The best moves found so far, kept in a min-heap of at most capacity moves
+  so that the weakest kept move is always at the front. Ties keep the move
+  found first, and a move already kept is not added again. A move added
+  provisionally, before the search, loses every tie until the search finds
+  it too, so that what is kept does not depend on it.
+  */
+  struct TopMoves {
+    // the order moves added provisionally are ranked in, after any other
+    static constexpr size_t PROVISIONAL = SIZE_MAX / 2;
+
+    size_t capacity;
+    size_t offered;
+    std::vector<std::pair<RankedMove, size_t>> heap;
+
+    TopMoves(size_t capacity) : capacity(capacity), offered(0) {}
+
+    // Returns the points a move must beat to be kept.
+    unsigned int threshold() const;
+    void add(const RankedMove &move, bool provisional = false);
+    // Returns the kept moves, best first.
+    std::vector<RankedMove> sorted() const;
+  };
+
+  /*
+  Points known for a partial move, used to bound what completing it can score.
+
+  word_points: letters of the main word so far, letter multipliers applied
+  word_multiplier: product of the word multipliers under placed tiles
+  cross_points: full value of the perpendicular words formed so far
+  placed: number of tiles placed from the rack
+  */
+  struct PartialScore {
+    unsigned int word_points = 0;
+    unsigned int word_multiplier = 1;
+    unsigned int cross_points = 0;
+    size_t placed = 0;
+  };
+
+  /*
+  One node the trie walk of a partial move may be at. A blank in the move
+  stands for every letter it could be at once, so a walk through a blank is
+  at several nodes, and the blank's letter is only chosen once a word ends.
+
+  node: the node for the word so far
+  parent: the branch one step before this one
+  letter: the letter the tile placed at this step stands for if it is a
+      blank, '\0' otherwise
+  */
+  struct Branch {
+    const Dictionary::TrieNode *node;
+    size_t parent;
+    char letter;
+  };
+
+  /*
+  State shared by every recursive call while searching one board.
+
+  rack, hand_size: the tiles being played and the hand size they came from
+  packed_rack: rack as per-letter counts, copied for each search
+  anchor: the anchor currently being searched; a move must cover it
+  direction: the direction of the anchor being searched
+  deadline: when the search must give up (time_point::max() if never)
+  timed_out: set once the deadline has been seen to pass
+  has_move: whether a move has been found, after which the deadline stops the
+      search
+  nodes: number of search nodes visited, used to throttle clock reads
+  threshold: points a move must beat to matter; subtrees whose bound cannot
+      beat it are cut (only if pruning)
+  counters: where to count the search's work, or nullptr if not instrumented
+  branches: for each step of the search along the line, the branches the
+      partial move being built is at (reused between partial moves)
+  followers: for each step, scratch space for the branches after it
+  rack_letters: the letters in the rack, one bit per letter
+  spellable: the letters the lexicon filter allows, one bit per letter
+  marks, marked: the lexicon filter's mark for each trie node and the nodes
+      marked so far, or nullptr if it is off
+  cross_words: whether each perpendicular word checked so far is in the
+      dictionary, or nullptr if not remembered
+  */
+  struct SearchContext {
+    const Board &board;
+    const Dictionary &dictionary;
+    const BoardState &state;
+    const TileCollection &rack;
+    PackedRack packed_rack;
+    size_t hand_size;
+    Board::Position anchor;
+    Direction direction;
+    std::chrono::steady_clock::time_point deadline;
+    bool timed_out;
+    bool has_move;
+    size_t nodes;
+
+    bool pruning;
+    unsigned int threshold;
+    unsigned int max_tile_points;
+    bool bingo_possible;
+    SearchStats &stats;
+    SearchCounters *counters;
+    std::vector<std::vector<Branch>> branches;
+    std::vector<std::vector<Branch>> followers;
+    uint32_t rack_letters;
+    uint32_t spellable;
+    std::vector<uint8_t> *marks;
+    std::vector<uint32_t> *marked;
+    std::pmr::unordered_map<std::pmr::string, bool> *cross_words;
+
+    static constexpr uint8_t UNMARKED = 0;
+    static constexpr uint8_t FINISHES = 1;
+    static constexpr uint8_t DEAD_END = 2;
+
+    SearchContext(const Board &board, const Dictionary &dictionary,
+                  const BoardState &state, const TileCollection &rack,
+                  size_t hand_size, SearchStats &stats);
+
+    // Returns whether the deadline has passed and a move has been found,
+    // reading the clock only every few hundred nodes.
+    bool out_of_time();
+
+    // Returns score after placing tile on the empty square.
+    PartialScore place(PartialScore score, Board::Position square,
+                       const TileKind &tile) const;
+
+    // Returns whether move is a single DOWN tile that also forms an ACROSS
+    // word: the same placement is then generated from the ACROSS anchor, so
+    // it is only emitted there.
+    bool across_twin(const PackedMove &move) const;
+
+    // Returns the rack tile a packed tile was made from.
+    TileKind tile_of(unsigned char packed) const;
+
+    // Returns whether some word below node can be spelled with spellable
+    // letters (always true if the lexicon filter is off).
+    bool can_finish(const Dictionary::TrieNode *node);
+
+    // Makes the lexicon filter allow exactly letters, forgetting the marks
+    // made for any others.
+    void spell_with(uint32_t letters);
+
+    // Sets the branches after step to those of the branches at step that
+    // continue with letter. Returns whether there are any.
+    bool advance(size_t step, char letter);
+
+    // Calls try_tile with every tile in remaining_tiles that some branch at
+    // step can continue with by one of letters, after setting the branches
+    // after step to where it leads. A blank is tried once, continuing every
+    // branch with every one of letters.
+    template <class TryTile>
+    void each_next_tile(size_t step, const PackedRack &remaining_tiles,
+                        uint32_t letters, TryTile try_tile);
+
+    // Adds move to legal_moves once for every branch at step that ends a
+    // word, with its blanks standing for that branch's letters. All but the
+    // first are marked as alternatives.
+    void emit(PackedMove move, size_t step,
+              std::pmr::vector<PackedMove> &legal_moves);
+
+    // Returns whether the shortest word below the branches at step fits on
+    // the squares from square on, its empty ones filled from tiles_left
+    // tiles. If not, no word below them does.
+    bool fits(Board::Position square, size_t step, size_t tiles_left) const;
+
+    // Returns the most letters any word below the branches at step has left.
+    size_t longest(size_t step) const;
+
+    // Returns the most a move could score if it has score so far, continues
+    // at square in direction and may still use remaining_tiles on up to
+    // reach empty squares.
+    unsigned int bound(Board::Position square, const PartialScore &score,
+                       const PackedRack &remaining_tiles,
+                       size_t reach) const;
+  };
+
+  /*
+  Returns up to n of the best moves for rack on board, best first. The
+  search gives up at deadline.
+  */
+  std::vector<RankedMove>
+  search(const Board &board, const Dictionary &dictionary,
+         const BoardState &state, const TileCollection &rack, size_t n,
+         std::chrono::steady_clock::time_point deadline) const;
+
+  /*
+  Brings line_keys up to date with board and drops the cached moves of every
+  line whose key changed.
+  */
+  void refresh_move_cache(const Board &board,
+                          const Dictionary &dictionary) const;
+
+  /*
+  Sets move to the opening book's move for this player's rack and returns
+  true, or returns false if the book cannot give one for this board.
+  */
+  bool get_book_move(const Board &board, const Dictionary &dictionary,
+                     Move &move) const;
+
+  /*
+  Returns the move chosen by two-ply search (see set_lookahead).
+  */
+  Move get_lookahead_move(const Board &board,
+                          const Dictionary &dictionary) const;
 
   /*
   Searches all possible prefixes of size up to limit and calls extend_right for
   each one
 
-  anchor: The board position for the anchor square
-  partial_word: the partial word that has already been searched
-  partial_move: the Move object associated with the partial word (has tiles for
-  each letter in partial_word) node: The node in the Dictionary associated with
-  partial_word limit: The max prefix size to consider remaining_tiles: The tiles
-  that can still be used to form a move Passed by reference Tiles should be
-  removed when every searching forward on that tile Tiles should be put back in
-  remaining_tiles when backtracking legal_moves: A vector that accumulates Moves
-  that create a valid word Note: Does not necessarily need to check
-  perpendicular words while searching but it can if you prefer. board: a
-  reference to the scrabble board
-  */
-  void left_part(Board::Position anchor_pos, std::string partial_word,
-                 Move partial_move, std::shared_ptr<Dictionary::TrieNode> node,
-                 size_t limit, TileCollection &remaining_tiles,
-                 std::vector<Move> &legal_moves, const Board &board,
-                 const Dictionary &d) const;
+  partial_move: the tiles of the prefix built so far, blanks not yet given
+      letters
+  step: where in ctx.branches the Dictionary nodes associated with the
+      prefix are
+  limit: The max prefix size to consider
+  remaining_tiles: The tiles that can still be used to form a move
+      Passed by reference
+      Tiles are removed when searching forward on that tile and put back in
+      remaining_tiles when backtracking
+  legal_moves: A vector that accumulates Moves that create a valid word
+      Note: perpendicular words are checked when moves are scored
+  ctx: the board, dictionary and anchor being searched
+  */
+  void left_part(PackedMove partial_move, size_t step, size_t limit, PackedRack &remaining_tiles,
+                 std::pmr::vector<PackedMove> &legal_moves,
+                 SearchContext &ctx) const;
 
   /*
   Given a square (not necessarily an anchor square) and a prefix finds all legal
   ways to extend the word to make valid words.
 
   square: The board position to search from
-  partial_word: the partial word that has already been formed
-  partial_move: the Move object associated with the partial word
-      (has tiles for each letter in partial_word, unless that tile was already
-  on the board) node: The node in the Dictionary associated with partial_word
+  partial_move: the tiles placed so far (not those already on the board),
+      blanks not yet given letters
+  step: where in ctx.branches the Dictionary nodes associated with the word
+      so far are, board tiles included
+  score: the points known for partial_move so far
   remaining_tiles: The tiles that can still be used to form a move
-      Passed by reference
-      Tiles should be removed when every searching forward on that tile
-      Tiles should be put back in remaining_tiles when backtracking
   legal_moves: A vector that accumulates Moves that create a valid word
-      Note: Does not necessarily need to check perpendicular words while
-  searching but it can if you prefer. board: a reference to the scrabble board
+  ctx: the board, dictionary and anchor being searched
+  */
+  void extend_right(Board::Position square, PackedMove partial_move,
+                    size_t step, PartialScore score,
+                    PackedRack &remaining_tiles,
+                    std::pmr::vector<PackedMove> &legal_moves,
+                    SearchContext &ctx) const;
+
+  /*
+  Generates every candidate move through one anchor into legal_moves.
+  */
+  void search_anchor(const Board::Anchor &anchor,
+                     PackedRack &remaining_tiles,
+                     std::pmr::vector<PackedMove> &legal_moves,
+                     SearchContext &ctx) const;
+
+  /*
+  Returns the most any move through an anchor could score: every square it
+  could reach counted with its multipliers, the rack at its best letter
+  multiplier, every cross word it could form and the bingo bonus. Anchors are
+  searched in decreasing order of this bound.
+  */
+  unsigned int anchor_bound(const Board::Anchor &anchor,
+                            SearchContext &ctx) const;
+
+  /*
+  Adds the bingos found before the search to bingos, and returns a threshold
+  the n best moves must beat: one less than the points of the n-th best
+  bingo, or zero if there are fewer than n. Bingos are looked up in the
+  dictionary's anagram index from the rack alone, fitted into empty stretches
+  of a line touching an anchor, and from the rack plus one board tile, fitted
+  through that tile. Once the deadline passes, only the placements fitted so
+  far are scored.
   */
-  void extend_right(Board::Position square, std::string partial_word,
-                    Move partial_move,
-                    std::shared_ptr<Dictionary::TrieNode> node,
-                    TileCollection &remaining_tiles,
-                    std::vector<Move> &legal_moves, const Board &board,
-                    const Dictionary &d) const;
+  unsigned int bingo_bound(SearchContext &ctx, size_t n,
+                           std::vector<RankedMove> &bingos) const;
 
   /*
-      Searches the vector of legal moves for the highest scoring move
-  Ties broken arbitrarily
+  Scores the vector of legal moves and adds those that form only dictionary
+  words and are worth more than ctx.threshold to scored. A move using a full
+  hand scores the empty hand bonus on top of its placement points. Of a move
+  and its alternatives, only the first that forms only dictionary words is
+  added. The words of a move are checked in one batch, except perpendicular
+  words already in ctx.cross_words.
   */
-  Move get_best_move(std::vector<Move> legal_moves, const Board &board,
-                     const Dictionary &dictionary) const;
+  void get_best_move(const std::pmr::vector<PackedMove> &legal_moves,
+                     SearchContext &ctx,
+                     std::vector<RankedMove> &scored) const;
 };
 
 #endif
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "computer_player.h"
+#include "dictionary.h"
+#include "exceptions.h"
+#include "scrabble.h"
+#include "scrabble_config.h"
+#include "tile_bag.h"
+
+using namespace std;
+
+
+// Position corpus: seeded self-play games and the positions reached in them,
+// used to time ComputerPlayer::get_move against a stored baseline.
+//
+// A corpus file holds one line per game, listing every move placed in it,
+// followed by one line per position taken from that game:
+//
+//     game -8,8,hello |6,9,w?orld ...
+//     position <moves placed so far> <rack>
+//
+// A move is its direction (- or |), 1-based row and column, and its tiles,
+// with a blank written as ? followed by the letter it stands for. A rack is
+// its letters, with ? for each blank.
+//
+// A baseline file holds one line per position: the points of the move found
+// and the microseconds get_move took.
+
+struct Game {
+    vector<Move> moves;
+    vector<pair<size_t, vector<TileKind>>> positions;
+};
+
+static const double DEFAULT_TOLERANCE = 0.10;
+static const size_t MAX_TURNS = 100;
+
+
+static string format_move(const Move& move) {
+    ostringstream out;
+    out << (move.direction == Direction::ACROSS ? "-" : "|") << move.row + 1 << "," << move.column + 1 << ",";
+    for (const TileKind& tile : move.tiles) {
+        out << tile.letter;
+        if (tile.letter == TileKind::BLANK_LETTER) {
+            out << tile.assigned;
+        }
+    }
+    return out.str();
+}
+
+static TileKind tile_for(const TileBag& bag, char letter) {
+    auto kind = bag.get_kinds().find(letter);
+    if (kind == bag.get_kinds().end()) {
+        throw FileException("CORPUS: unknown tile " + string(1, letter));
+    }
+    return kind->second;
+}
+
+static vector<TileKind> parse_tiles(const TileBag& bag, const string& letters) {
+    vector<TileKind> tiles;
+    for (size_t i = 0; i < letters.size(); ++i) {
+        TileKind tile = tile_for(bag, letters[i]);
+        if (tile.letter == TileKind::BLANK_LETTER && i + 1 < letters.size() && letters[i + 1] != TileKind::BLANK_LETTER) {
+            tile.assigned = letters[++i];
+        }
+        tiles.push_back(tile);
+    }
+    return tiles;
+}
+
+static Move parse_move(const TileBag& bag, const string& token) {
+    istringstream in(token.substr(1));
+    size_t row, column;
+    char comma1, comma2;
+    string letters;
+    if (token.empty() || !(in >> row >> comma1 >> column >> comma2 >> letters) || row == 0 || column == 0) {
+        throw FileException("CORPUS: bad move " + token);
+    }
+    Direction direction = token[0] == '-' ? Direction::ACROSS : Direction::DOWN;
+    return Move(parse_tiles(bag, letters), row - 1, column - 1, direction);
+}
+
+static vector<Game> read_corpus(const string& file_path, const TileBag& bag) {
+    ifstream file(file_path);
+    if (!file) {
+        throw FileException("CORPUS: cannot open " + file_path);
+    }
+
+    vector<Game> games;
+    string line;
+    while (getline(file, line)) {
+        istringstream in(line);
+        string kind;
+        in >> kind;
+        if (kind == "game") {
+            games.push_back(Game());
+            string token;
+            while (in >> token) {
+                games.back().moves.push_back(parse_move(bag, token));
+            }
+        } else if (kind == "position") {
+            size_t turn;
+            string rack;
+            if (games.empty() || !(in >> turn >> rack) || turn > games.back().moves.size()) {
+                throw FileException("CORPUS: bad position " + line);
+            }
+            games.back().positions.push_back({turn, parse_tiles(bag, rack)});
+        }
+    }
+    return games;
+}
+
+static string format_rack(const TileCollection& rack) {
+    string letters;
+    for (const TileKind& tile : rack.get_tiles()) {
+        letters += tile.letter;
+    }
+    return letters;
+}
+
+// Plays games computer against computer, writing every game and the positions
+// reached after its first move.
+static int generate(const ScrabbleConfig& config, const string& corpus_path, size_t game_count) {
+    Dictionary dictionary = Dictionary::read(config.dictionary_file_path);
+    ofstream out(corpus_path);
+    if (!out) {
+        throw FileException("CORPUS: cannot write " + corpus_path);
+    }
+    out << "# scrabble position corpus" << endl;
+
+    size_t position_count = 0;
+    for (size_t game = 0; game < game_count; ++game) {
+        Board board = Board::read(config.board_file_path);
+        TileBag bag = TileBag::read(config.tile_bag_file_path, config.seed + game);
+        vector<ComputerPlayer> players(2, ComputerPlayer("cpu", config.hand_size));
+        // the players' hands are not visible from outside, so keep a copy
+        vector<TileCollection> racks(2);
+        for (size_t i = 0; i < players.size(); ++i) {
+            vector<TileKind> drawn = bag.remove_random_tiles(config.hand_size);
+            players[i].add_tiles(drawn);
+            for (const TileKind& tile : drawn) {
+                racks[i].add_tile(tile);
+            }
+        }
+
+        vector<Move> moves;
+        vector<string> positions;
+        size_t sequential_passes = 0;
+        for (size_t turn = 0; turn < MAX_TURNS && sequential_passes < players.size(); ++turn) {
+            ComputerPlayer& player = players[turn % players.size()];
+            TileCollection& rack = racks[turn % players.size()];
+            if (!moves.empty()) {
+                positions.push_back("position " + to_string(moves.size()) + " " + format_rack(rack));
+            }
+
+            Move move = player.get_move(board, dictionary);
+            if (move.kind != MoveKind::PLACE) {
+                sequential_passes++;
+                continue;
+            }
+            sequential_passes = 0;
+            board.place(move);
+            moves.push_back(move);
+
+            player.remove_tiles(move.tiles);
+            for (const TileKind& tile : move.tiles) {
+                rack.remove_tile(tile);
+            }
+            vector<TileKind> drawn = bag.remove_random_tiles(min(bag.count_tiles(), config.hand_size - rack.count_tiles()));
+            player.add_tiles(drawn);
+            for (const TileKind& tile : drawn) {
+                rack.add_tile(tile);
+            }
+            if (rack.count_tiles() == 0) {
+                break;
+            }
+        }
+
+        out << "game";
+        for (const Move& move : moves) {
+            out << " " << format_move(move);
+        }
+        out << endl;
+        for (const string& position : positions) {
+            out << position << endl;
+        }
+        position_count += positions.size();
+    }
+    cout << "Wrote " << game_count << " games and " << position_count << " positions to " << corpus_path << endl;
+    return 0;
+}
+
+struct Timing {
+    unsigned int points;
+    long microseconds;
+};
+
+// Times get_move on every position of the corpus, each with a fresh player.
+static vector<Timing> time_corpus(const ScrabbleConfig& config, const string& corpus_path) {
+    Dictionary dictionary = Dictionary::read(config.dictionary_file_path);
+    TileBag bag = TileBag::read(config.tile_bag_file_path, config.seed);
+    vector<Game> games = read_corpus(corpus_path, bag);
+
+    vector<Timing> timings;
+    for (const Game& game : games) {
+        Board board = Board::read(config.board_file_path);
+        size_t placed = 0;
+        for (const pair<size_t, vector<TileKind>>& position : game.positions) {
+            for (; placed < position.first; ++placed) {
+                board.place(game.moves[placed]);
+            }
+            ComputerPlayer player("cpu", config.hand_size);
+            player.add_tiles(position.second);
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            Move move = player.get_move(board, dictionary);
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+            unsigned int points = 0;
+            if (move.kind == MoveKind::PLACE) {
+                points = board.test_place(move).points;
+                if (move.tiles.size() == config.hand_size) {
+                    points += Scrabble::EMPTY_HAND_BONUS;
+                }
+            }
+            timings.push_back({points, chrono::duration_cast<chrono::microseconds>(end - start).count()});
+        }
+    }
+    return timings;
+}
+
+static long total_microseconds(const vector<Timing>& timings) {
+    long total = 0;
+    for (const Timing& timing : timings) {
+        total += timing.microseconds;
+    }
+    return total;
+}
+
+static int record(const ScrabbleConfig& config, const string& corpus_path, const string& baseline_path) {
+    vector<Timing> timings = time_corpus(config, corpus_path);
+    ofstream out(baseline_path);
+    if (!out) {
+        throw FileException("CORPUS: cannot write " + baseline_path);
+    }
+    for (const Timing& timing : timings) {
+        out << timing.points << " " << timing.microseconds << endl;
+    }
+    cout << "Recorded " << timings.size() << " positions in " << total_microseconds(timings) / 1000 << " ms to " << baseline_path << endl;
+    return 0;
+}
+
+// Fails if the corpus takes more than (1 + tolerance) times the baseline time,
+// or if any position now scores differently.
+static int check(const ScrabbleConfig& config, const string& corpus_path, const string& baseline_path, double tolerance) {
+    ifstream in(baseline_path);
+    if (!in) {
+        throw FileException("CORPUS: cannot open " + baseline_path);
+    }
+    vector<Timing> baseline;
+    Timing timing;
+    while (in >> timing.points >> timing.microseconds) {
+        baseline.push_back(timing);
+    }
+
+    vector<Timing> timings = time_corpus(config, corpus_path);
+    if (timings.size() != baseline.size()) {
+        cout << "FAIL: corpus has " << timings.size() << " positions, baseline has " << baseline.size() << endl;
+        return 1;
+    }
+
+    size_t changed = 0;
+    vector<pair<double, size_t>> slowdowns;
+    for (size_t i = 0; i < timings.size(); ++i) {
+        if (timings[i].points != baseline[i].points) {
+            changed++;
+            cout << "Position " << i << " scores " << timings[i].points << ", baseline " << baseline[i].points << endl;
+        }
+        slowdowns.push_back({double(timings[i].microseconds + 1) / (baseline[i].microseconds + 1), i});
+    }
+    sort(slowdowns.rbegin(), slowdowns.rend());
+    for (size_t i = 0; i < slowdowns.size() && i < 5; ++i) {
+        size_t position = slowdowns[i].second;
+        cout << "Position " << position << ": " << timings[position].microseconds << " us, baseline "
+             << baseline[position].microseconds << " us" << endl;
+    }
+
+    long total = total_microseconds(timings);
+    long baseline_total = total_microseconds(baseline);
+    double ratio = double(total) / baseline_total;
+    cout << timings.size() << " positions: " << total / 1000 << " ms, baseline " << baseline_total / 1000 << " ms ("
+         << ratio << "x, tolerance " << 1 + tolerance << "x)" << endl;
+
+    if (changed > 0 || ratio > 1 + tolerance) {
+        cout << "FAIL" << endl;
+        return 1;
+    }
+    cout << "PASS" << endl;
+    return 0;
+}
+
+static int usage(const char* name) {
+    cerr << "Usage: " << name << " generate <configuration file> <corpus file> <games>" << endl;
+    cerr << "       " << name << " record <configuration file> <corpus file> <baseline file>" << endl;
+    cerr << "       " << name << " check <configuration file> <corpus file> <baseline file> [tolerance]" << endl;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        return usage(argv[0]);
+    }
+    string command = argv[1];
+
+    try {
+        ScrabbleConfig config = ScrabbleConfig::read(argv[2]);
+        if (command == "generate") {
+            return generate(config, argv[3], strtoul(argv[4], nullptr, 10));
+        } else if (command == "record") {
+            return record(config, argv[3], argv[4]);
+        } else if (command == "check") {
+            double tolerance = argc > 5 ? strtod(argv[5], nullptr) : DEFAULT_TOLERANCE;
+            return check(config, argv[3], argv[4], tolerance);
+        }
+    } catch (const FileException& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return usage(argv[0]);
+}
@@ -1,49 +1,512 @@
 #include "dictionary.h"
 #include "exceptions.h"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <climits>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <thread>
 #include <vector>
 
 using namespace std;
 
-string lower(string str) {
-  transform(str.cbegin(), str.cend(), str.begin(), ::tolower);
-  return str;
-}
+// FNV-1a, 64 bit
+static const uint64_t HASH_OFFSET = 14695981039346656037ull;
+static const uint64_t HASH_PRIME = 1099511628211ull;
 
-// Implemented for you to read dictionary file and
-// construct dictionary trie graph for you
-Dictionary Dictionary::read(const std::string &file_path) {
-  ifstream file(file_path);
+// Returns the whole of a file. Throws a FileException if it cannot be read.
+static string read_file(const string &file_path) {
+  ifstream file(file_path, ios::binary);
   if (!file) {
     throw FileException("cannot open dictionary file!");
   }
-  std::string word;
+  file.seekg(0, ios::end);
+  string text(static_cast<size_t>(file.tellg()), '\0');
+  file.seekg(0, ios::beg);
+  file.read(&text[0], text.size());
+  if (!file) {
+    throw FileException("cannot read dictionary file!");
+  }
+  return text;
+}
+
+// whitespace as `>>` splits words in the "C" locale
+static bool is_space(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Lowercases text in place and calls f with a view of each word in it, in
+// order, so that no word is copied.
+template <class F> static void each_word(string &text, F f) {
+  char *end = &text[0] + text.size();
+  for (char *cur = &text[0]; cur != end;) {
+    while (cur != end && is_space(*cur)) {
+      cur++;
+    }
+    char *start = cur;
+    for (; cur != end && !is_space(*cur); cur++) {
+      if (*cur >= 'A' && *cur <= 'Z') {
+        *cur += 'a' - 'A';
+      }
+    }
+    if (start != cur) {
+      f(string_view(start, cur - start));
+    }
+  }
+}
+
+static uint64_t hash_word(uint64_t hash, string_view word) {
+  for (char letter : word) {
+    hash = (hash ^ static_cast<unsigned char>(letter)) * HASH_PRIME;
+  }
+  return (hash ^ '\n') * HASH_PRIME;
+}
+
+// Adds words to a trie, each below as much of the path of the word before
+// it as they share. In sorted order a word's new letters follow every
+// letter already in their nodes, so they are added at the end of `nexts`
+// without a search; words out of order are added all the same, just slower.
+class SortedBuilder {
+public:
+  SortedBuilder(Dictionary::TrieNode *root, size_t &node_count)
+      : path(1, root), node_count(node_count) {}
+
+  // Adds word, numbering new nodes from node_count on. Returns whether the
+  // word is new.
+  bool add(string_view word) {
+    size_t common = 0;
+    while (common < last.size() && common < word.size() &&
+           last[common] == word[common]) {
+      common++;
+    }
+    path.resize(common + 1);
+    Dictionary::TrieNode *cur = path.back();
+    for (size_t i = common; i < word.size(); i++) {
+      shared_ptr<Dictionary::TrieNode> &next =
+          cur->nexts.emplace_hint(cur->nexts.end(), word[i], nullptr)->second;
+      if (next == nullptr) {
+        next = make_shared<Dictionary::TrieNode>();
+        next->id = node_count++;
+      }
+      cur = next.get();
+      path.push_back(cur);
+    }
+    last.assign(word.data(), word.size());
+    if (cur->is_final) {
+      return false;
+    }
+    cur->is_final = true;
+    return true;
+  }
+
+private:
+  // the nodes of last, root first
+  vector<Dictionary::TrieNode *> path;
+  string last;
+  size_t &node_count;
+};
+
+// Creates the dictionary from a file of words separated by whitespace, read
+// in one go and split in place.
+Dictionary Dictionary::read(const std::string &file_path) {
+  string text = read_file(file_path);
   Dictionary dictionary;
   dictionary.root = make_shared<TrieNode>();
+  dictionary.reversed_root = make_shared<TrieNode>();
+  dictionary.reversed_root->id = 1;
+  dictionary.node_count = 2;
+  dictionary.hash = HASH_OFFSET;
 
-  while (!file.eof()) {
-    file >> word;
-    if (word.empty()) {
-      break;
+  SortedBuilder words(dictionary.root.get(), dictionary.node_count);
+  each_word(text, [&](string_view word) {
+    dictionary.hash = hash_word(dictionary.hash, word);
+    if (words.add(word)) {
+      add_anagram(dictionary.anagrams, string(word));
     }
-    dictionary.add_word(lower(word));
+  });
+
+  // reversing the whole text spells every word in it back to front
+  string backwards(text.rbegin(), text.rend());
+  vector<string_view> reversed;
+  each_word(backwards, [&](string_view word) { reversed.push_back(word); });
+  sort(reversed.begin(), reversed.end());
+  SortedBuilder ends(dictionary.reversed_root.get(), dictionary.node_count);
+  for (string_view word : reversed) {
+    ends.add(word);
   }
 
+  annotate(dictionary.root.get(), 0);
+  annotate(dictionary.reversed_root.get(), 0);
+  dictionary.flatten();
   return dictionary;
 }
 
-bool Dictionary::is_word(const string &word) const {
-  shared_ptr<TrieNode> cur = find_prefix(word);
-  if (cur == nullptr)
-    return false;
-  // HW5: IMPLEMENT HERE
-  // return whether the word is a valid
-  // word in the dictionary
-  return cur->is_final;
+// Calls task(i) for every i below count on up to `threads` threads, each
+// taking the next i no other thread has taken.
+static void run_tasks(size_t count, size_t threads,
+                      const function<void(size_t)> &task) {
+  atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      task(i);
+    }
+  };
+  vector<thread> workers;
+  for (size_t i = 1; i < min(threads, count); i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (thread &worker : workers) {
+    worker.join();
+  }
+}
+
+// The part of a trie below one letter, built apart from the others.
+struct Subtrie {
+  char letter;
+  bool reversed;
+  // every word starting with letter, spelled back to front if reversed
+  vector<string_view> words;
+  shared_ptr<Dictionary::TrieNode> node;
+  size_t node_count = 0;
+};
+
+Dictionary Dictionary::read_parallel(const string &file_path, size_t threads) {
+  string text = read_file(file_path);
+  Dictionary dictionary;
+  dictionary.root = make_shared<TrieNode>();
+  dictionary.reversed_root = make_shared<TrieNode>();
+  dictionary.reversed_root->id = 1;
+  dictionary.node_count = 2;
+  dictionary.hash = HASH_OFFSET;
+
+  // a subtrie per first letter of the words and of the words reversed
+  vector<Subtrie> parts[2];
+  size_t part_of[2][UCHAR_MAX + 1];
+  fill(&part_of[0][0], &part_of[0][0] + 2 * (UCHAR_MAX + 1), SIZE_MAX);
+  auto add_to_part = [&](int reversed, string_view word) {
+    size_t &part = part_of[reversed][static_cast<unsigned char>(word[0])];
+    if (part == SIZE_MAX) {
+      part = parts[reversed].size();
+      parts[reversed].push_back({word[0], reversed != 0, {}, nullptr, 0});
+    }
+    parts[reversed][part].words.push_back(word);
+  };
+  each_word(text, [&](string_view word) {
+    dictionary.hash = hash_word(dictionary.hash, word);
+    add_to_part(0, word);
+  });
+  string backwards(text.rbegin(), text.rend());
+  each_word(backwards, [&](string_view word) { add_to_part(1, word); });
+  for (vector<Subtrie> &side : parts) {
+    sort(side.begin(), side.end(), [](const Subtrie &lhs, const Subtrie &rhs) {
+      return lhs.letter < rhs.letter;
+    });
+  }
+
+  vector<Subtrie *> tasks;
+  for (vector<Subtrie> &side : parts) {
+    for (Subtrie &part : side) {
+      tasks.push_back(&part);
+    }
+  }
+  // the biggest first, so that no thread is left with one at the end
+  sort(tasks.begin(), tasks.end(), [](const Subtrie *lhs, const Subtrie *rhs) {
+    return lhs->words.size() > rhs->words.size();
+  });
+
+  vector<AnagramIndex> anagrams(parts[0].size());
+  run_tasks(tasks.size(), threads, [&](size_t i) {
+    Subtrie &part = *tasks[i];
+    part.node = make_shared<TrieNode>();
+    part.node_count = 1;
+    SortedBuilder words(part.node.get(), part.node_count);
+    if (part.reversed) {
+      // added sorted, as read adds them
+      sort(part.words.begin(), part.words.end());
+      for (string_view word : part.words) {
+        words.add(word.substr(1));
+      }
+      return;
+    }
+    AnagramIndex &index = anagrams[&part - parts[0].data()];
+    for (string_view word : part.words) {
+      if (words.add(word.substr(1))) {
+        add_anagram(index, string(word));
+      }
+    }
+  });
+
+  // number the nodes of each subtrie after those of the ones before it
+  vector<size_t> first_ids;
+  for (vector<Subtrie> &side : parts) {
+    for (Subtrie &part : side) {
+      first_ids.push_back(dictionary.node_count);
+      dictionary.node_count += part.node_count;
+    }
+  }
+  run_tasks(tasks.size(), threads, [&](size_t i) {
+    Subtrie &part = *tasks[i];
+    size_t first = part.reversed ? parts[0].size() : 0;
+    annotate(part.node.get(),
+             first_ids[first + (&part - parts[part.reversed].data())]);
+  });
+
+  for (int reversed = 0; reversed < 2; reversed++) {
+    TrieNode *root = reversed ? dictionary.reversed_root.get()
+                              : dictionary.root.get();
+    for (Subtrie &part : parts[reversed]) {
+      root->nexts.emplace_hint(root->nexts.end(), part.letter, part.node);
+    }
+    annotate_node(root);
+  }
+  for (AnagramIndex &index : anagrams) {
+    for (auto &entry : index) {
+      vector<string> &words = dictionary.anagrams[entry.first];
+      words.insert(words.end(), entry.second.begin(), entry.second.end());
+    }
+  }
+  dictionary.flatten();
+  return dictionary;
+}
+
+vector<string> Dictionary::find_anagrams(string letters, size_t blanks) const {
+  vector<string> words;
+  size_t length = letters.size() + blanks;
+  if (length < MIN_ANAGRAM_LENGTH || length > MAX_ANAGRAM_LENGTH) {
+    return words;
+  }
+  sort(letters.begin(), letters.end());
+  collect_anagrams(letters, blanks, 'a', words);
+  return words;
+}
+
+// Tries every letter from first_blank on for the next blank, so that each
+// choice of letters for the blanks is looked up once whatever their order.
+void Dictionary::collect_anagrams(const string &letters, size_t blanks,
+                                  char first_blank,
+                                  vector<string> &words) const {
+  if (blanks == 0) {
+    auto found = anagrams.find(letters);
+    if (found != anagrams.end()) {
+      words.insert(words.end(), found->second.begin(), found->second.end());
+    }
+    return;
+  }
+  for (char letter = first_blank; letter <= 'z'; letter++) {
+    string with_blank = letters;
+    with_blank.insert(
+        upper_bound(with_blank.begin(), with_blank.end(), letter), letter);
+    collect_anagrams(with_blank, blanks - 1, letter, words);
+  }
+}
+
+// Returns the node below node spelled by letters, or nullptr if there is
+// none. Walks raw pointers: copying shared_ptrs would cost a reference count
+// update per letter.
+static const Dictionary::TrieNode *descend(const Dictionary::TrieNode *node,
+                                           string_view letters) {
+  for (char letter : letters) {
+    auto next = node->nexts.find(letter);
+    if (next == node->nexts.end())
+      return nullptr;
+    node = next->second.get();
+  }
+  return node;
+}
+
+bool Dictionary::is_word(string_view word) const {
+  const TrieNode *node = descend(root.get(), word);
+  return node != nullptr && node->is_final;
+}
+
+// Returns the bit of letter in FlatNode::letters, in the order nexts keeps
+// the letters, or UINT_MAX if it has none.
+static unsigned flat_bit(char letter) {
+  if (letter >= 'a' && letter <= 'z') {
+    return letter - 'a' + 1;
+  }
+  return letter == '\'' ? 0 : UINT_MAX;
+}
+
+void Dictionary::flatten() {
+  flat.assign(1, {root->is_final ? FlatNode::FINAL_BIT : 0, 0, root.get()});
+  if (!flatten_children(0)) {
+    flat.clear();
+  }
+  flat.shrink_to_fit();
+}
+
+bool Dictionary::flatten_children(uint32_t index) {
+  const TrieNode *node = flat[index].node;
+  uint32_t first = flat.size();
+  flat[index].first_child = first;
+  for (const auto &next : node->nexts) {
+    unsigned bit = flat_bit(next.first);
+    if (bit == UINT_MAX) {
+      return false;
+    }
+    flat[index].letters |= 1u << bit;
+    const TrieNode *child = next.second.get();
+    flat.push_back({child->is_final ? FlatNode::FINAL_BIT : 0, 0, child});
+  }
+  // each child's subtrie goes right after the one before, so that a walk
+  // stays near where it has been
+  for (size_t i = 0; i < node->nexts.size(); i++) {
+    if (!flatten_children(first + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Dictionary::walk_flat(const string_view *prefixes, size_t count,
+                           uint32_t *indices) const {
+  for (size_t i = 0; i < count; i++) {
+    indices[i] = 0;
+  }
+
+  // one letter of every walk still going per round
+  for (size_t depth = 0, going = count; going > 0; depth++) {
+    going = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (indices[i] == NO_NODE || depth >= prefixes[i].size()) {
+        continue;
+      }
+      const FlatNode &node = flat[indices[i]];
+      unsigned bit = flat_bit(prefixes[i][depth]);
+      if (bit == UINT_MAX || (node.letters & (1u << bit)) == 0) {
+        indices[i] = NO_NODE;
+        continue;
+      }
+      // the children are in letter order, so the letters below this one
+      // count the children before it
+      indices[i] = node.first_child +
+                   __builtin_popcount(node.letters & ((1u << bit) - 1));
+      __builtin_prefetch(&flat[indices[i]]);
+      going++;
+    }
+  }
+}
+
+void Dictionary::find_prefixes(const string_view *prefixes, size_t count,
+                               const TrieNode **nodes) const {
+  uint32_t indices[MAX_BATCH_WALKS];
+  for (size_t first = 0; first < count; first += MAX_BATCH_WALKS) {
+    size_t walks = min(MAX_BATCH_WALKS, count - first);
+    if (flat.empty()) {
+      for (size_t i = 0; i < walks; i++) {
+        nodes[first + i] = descend(root.get(), prefixes[first + i]);
+      }
+      continue;
+    }
+    walk_flat(prefixes + first, walks, indices);
+    for (size_t i = 0; i < walks; i++) {
+      nodes[first + i] =
+          indices[i] == NO_NODE ? nullptr : flat[indices[i]].node;
+    }
+  }
+}
+
+bool Dictionary::check_words(const string_view *words, size_t count,
+                             bool *results) const {
+  uint32_t indices[MAX_BATCH_WALKS];
+  const TrieNode *nodes[MAX_BATCH_WALKS];
+  bool all_found = true;
+  for (size_t first = 0; first < count; first += MAX_BATCH_WALKS) {
+    size_t walks = min(MAX_BATCH_WALKS, count - first);
+    if (flat.empty()) {
+      find_prefixes(words + first, walks, nodes);
+      for (size_t i = 0; i < walks; i++) {
+        results[first + i] = nodes[i] != nullptr && nodes[i]->is_final;
+      }
+    } else {
+      // the final flag is in the flat entry, so no TrieNode is read
+      walk_flat(words + first, walks, indices);
+      for (size_t i = 0; i < walks; i++) {
+        results[first + i] =
+            indices[i] != NO_NODE &&
+            (flat[indices[i]].letters & FlatNode::FINAL_BIT) != 0;
+      }
+    }
+    for (size_t i = 0; i < walks; i++) {
+      all_found = all_found && results[first + i];
+    }
+  }
+  return all_found;
+}
+
+bool Dictionary::all_words(const vector<string> &words) const {
+  string_view batch[MAX_BATCH_WALKS];
+  bool results[MAX_BATCH_WALKS];
+  for (size_t first = 0; first < words.size(); first += MAX_BATCH_WALKS) {
+    size_t count = min(MAX_BATCH_WALKS, words.size() - first);
+    for (size_t i = 0; i < count; i++) {
+      batch[i] = words[first + i];
+    }
+    if (!check_words(batch, count, results)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+shared_ptr<Dictionary::TrieNode>
+Dictionary::find_suffix(const string &suffix) const {
+  shared_ptr<TrieNode> cur = reversed_root;
+  for (auto letter = suffix.rbegin(); letter != suffix.rend(); letter++) {
+    auto next = cur->nexts.find(*letter);
+    if (next == cur->nexts.end())
+      return nullptr;
+    cur = next->second;
+  }
+  return cur;
+}
+
+uint32_t Dictionary::cross_letters(string_view before,
+                                   string_view after) const {
+  // walk after back to front in the reversed trie (or before, if nothing
+  // comes after, in the forward one), then try each letter that can come
+  // next against what is left
+  const TrieNode *cur = root.get();
+  string_view rest = after;
+  if (!after.empty()) {
+    cur = reversed_root.get();
+    for (auto letter = after.rbegin(); cur && letter != after.rend();
+         letter++) {
+      auto next = cur->nexts.find(*letter);
+      cur = next == cur->nexts.end() ? nullptr : next->second.get();
+    }
+    rest = before;
+  } else {
+    for (auto letter = before.begin(); cur && letter != before.end();
+         letter++) {
+      auto next = cur->nexts.find(*letter);
+      cur = next == cur->nexts.end() ? nullptr : next->second.get();
+    }
+  }
+  if (cur == nullptr) {
+    return 0;
+  }
+
+  uint32_t letters = 0;
+  for (const auto &next : cur->nexts) {
+    if (next.first < 'a' || next.first > 'z') {
+      continue;
+    }
+    const TrieNode *node = next.second.get();
+    for (auto letter = rest.rbegin(); node && letter != rest.rend(); letter++) {
+      auto found = node->nexts.find(*letter);
+      node = found == node->nexts.end() ? nullptr : found->second.get();
+    }
+    if (node != nullptr && node->is_final) {
+      letters |= 1u << (next.first - 'a');
+    }
+  }
+  return letters;
 }
 
 shared_ptr<Dictionary::TrieNode>
@@ -64,16 +527,248 @@ Dictionary::find_prefix(const string &prefix) const {
   return cur;
 }
 
-// Implemented for you to build the dictionary trie
-void Dictionary::add_word(const string &word) {
-  shared_ptr<TrieNode> cur = root;
-  for (char letter : word) {
-    if (cur->nexts.find(letter) == cur->nexts.end()) {
-      cur->nexts.insert({letter, make_shared<TrieNode>()});
+void Dictionary::add_anagram(AnagramIndex &anagrams, const string &word) {
+  if (word.size() >= MIN_ANAGRAM_LENGTH && word.size() <= MAX_ANAGRAM_LENGTH) {
+    string letters = word;
+    sort(letters.begin(), letters.end());
+    anagrams[letters].push_back(word);
+  }
+}
+
+// Sets the word count and remaining lengths of node and every node below it,
+// and moves their ids up by first_id.
+void Dictionary::annotate(TrieNode *node, size_t first_id) {
+  node->id += first_id;
+  for (const auto &next : node->nexts) {
+    annotate(next.second.get(), first_id);
+  }
+  annotate_node(node);
+}
+
+// Sets the word count and remaining lengths of node from its children's.
+void Dictionary::annotate_node(TrieNode *node) {
+  node->words = node->is_final;
+  node->min_length = node->is_final ? 0 : UINT8_MAX;
+  node->max_length = 0;
+  for (const auto &next : node->nexts) {
+    TrieNode *child = next.second.get();
+    node->words += child->words;
+    if (child->words == 0) {
+      continue;
+    }
+    node->min_length =
+        min<unsigned>(node->min_length, min(child->min_length + 1, UINT8_MAX));
+    node->max_length =
+        max<unsigned>(node->max_length, min(child->max_length + 1, UINT8_MAX));
+  }
+  if (node->words == 0) {
+    node->min_length = 0;
+  }
+}
+
+size_t Dictionary::get_memory_usage() const {
+  // a node shares its block with the shared_ptr's control block (two counts
+  // and a vtable pointer); each link to one is a red-black tree node of a
+  // color, three pointers and the letter and shared_ptr it holds
+  size_t node_bytes = sizeof(TrieNode) + 2 * sizeof(int) + sizeof(void *);
+  size_t link_bytes = 4 * sizeof(void *) +
+                      sizeof(pair<const char, shared_ptr<TrieNode>>);
+  // every node but the two roots hangs off another
+  size_t links = node_count > 2 ? node_count - 2 : 0;
+  size_t bytes = sizeof(*this) + node_count * node_bytes + links * link_bytes;
+  bytes += flat.capacity() * sizeof(FlatNode);
+
+  bytes += anagrams.bucket_count() * sizeof(void *);
+  for (const auto &entry : anagrams) {
+    bytes += sizeof(entry) + sizeof(void *) +
+             entry.second.capacity() * sizeof(string);
+  }
+  return bytes;
+}
+
+string Dictionary::word_at(size_t index) const {
+  string word;
+  const TrieNode *cur = root.get();
+  while (index >= cur->is_final) {
+    index -= cur->is_final;
+    map<char, shared_ptr<TrieNode>>::const_iterator it = cur->nexts.begin();
+    for (; it != cur->nexts.end() && index >= it->second->words; it++) {
+      index -= it->second->words;
+    }
+    if (it == cur->nexts.end()) {
+      return "";
+    }
+    word += it->first;
+    cur = it->second.get();
+  }
+  return word;
+}
+
+Dictionary::Query Dictionary::Query::pattern(string_view text) {
+  Query query;
+  for (size_t i = 0; i < text.size(); i++) {
+    char letter = tolower(text[i]);
+    if (letter == '*') {
+      // runs of * match no more than one does
+      if (query.slots.empty() || query.slots.back() != ANY_LETTERS) {
+        query.slots.push_back(ANY_LETTERS);
+      }
+    } else if (letter == '?') {
+      query.slots.push_back(ANY_LETTER);
+    } else if (letter >= 'a' && letter <= 'z') {
+      query.slots.push_back(1u << (letter - 'a'));
+    } else if (letter == '[') {
+      uint32_t letters = 0;
+      for (i++; i < text.size() && text[i] != ']'; i++) {
+        char allowed = tolower(text[i]);
+        if (allowed < 'a' || allowed > 'z') {
+          throw CommandException("invalid pattern: " + string(text));
+        }
+        letters |= 1u << (allowed - 'a');
+      }
+      if (i == text.size() || letters == 0) {
+        throw CommandException("invalid pattern: " + string(text));
+      }
+      query.slots.push_back(letters);
+    } else {
+      throw CommandException("invalid pattern: " + string(text));
+    }
+  }
+  if (query.slots.size() > MAX_SLOTS) {
+    throw CommandException("pattern too long: " + string(text));
+  }
+  return query;
+}
+
+Dictionary::Query Dictionary::Query::anagrams(string_view rack) {
+  Query query;
+  query.set_rack(rack);
+  query.slots.assign(rack.size(), ANY_LETTER);
+  if (query.slots.size() > MAX_SLOTS) {
+    throw CommandException("rack too long: " + string(rack));
+  }
+  return query;
+}
+
+void Dictionary::Query::set_rack(string_view tiles) {
+  fill(rack, rack + BLANKS + 1, 0);
+  for (char tile : tiles) {
+    char letter = tolower(tile);
+    if (letter == '?') {
+      rack[BLANKS]++;
+    } else if (letter >= 'a' && letter <= 'z') {
+      rack[letter - 'a']++;
+    } else {
+      throw CommandException("invalid rack: " + string(tiles));
+    }
+  }
+  from_rack = true;
+}
+
+Dictionary::Matches Dictionary::query(const Query &query) const {
+  return Matches(root.get(), query);
+}
+
+Dictionary::Matches::Matches(const TrieNode *root, const Query &query)
+    : query(query), fewest(query.slots.size() + 1, 0),
+      open(query.slots.size() + 1, false), tiles(SIZE_MAX), count(0) {
+  for (size_t i = query.slots.size(); i-- > 0;) {
+    bool any = query.slots[i] == Query::ANY_LETTERS;
+    fewest[i] = fewest[i + 1] + !any;
+    open[i] = open[i + 1] || any;
+  }
+  if (query.from_rack) {
+    tiles = 0;
+    for (uint8_t held : query.rack) {
+      tiles += held;
+    }
+  }
+  path.push_back({root, root->nexts.begin(), close(1), false});
+}
+
+uint64_t Dictionary::Matches::close(uint64_t slots) const {
+  for (size_t i = 0; i < query.slots.size(); i++) {
+    if ((slots >> i & 1) && query.slots[i] == Query::ANY_LETTERS) {
+      slots |= uint64_t(1) << (i + 1);
+    }
+  }
+  return slots;
+}
+
+uint64_t Dictionary::Matches::advance(uint64_t slots, char letter) const {
+  if (letter < 'a' || letter > 'z') {
+    return 0;
+  }
+  uint64_t reached = 0;
+  for (size_t i = 0; i < query.slots.size(); i++) {
+    if (!(slots >> i & 1)) {
+      continue;
+    }
+    if (query.slots[i] == Query::ANY_LETTERS) {
+      reached |= uint64_t(1) << i;
+    } else if (query.slots[i] >> (letter - 'a') & 1) {
+      reached |= uint64_t(1) << (i + 1);
+    }
+  }
+  return close(reached);
+}
+
+bool Dictionary::Matches::fits(uint64_t slots, const TrieNode *node,
+                               size_t most) const {
+  size_t longest = min<size_t>(node->max_length, most);
+  for (size_t i = 0; i <= query.slots.size(); i++) {
+    if ((slots >> i & 1) && fewest[i] <= longest &&
+        (open[i] || fewest[i] >= node->min_length)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Dictionary::Matches::next(string &found) {
+  while (!path.empty() && count < query.limit) {
+    Frame &top = path.back();
+    if (top.child == top.node->nexts.end()) {
+      // every word below top is found: give back its letter's tile
+      if (path.size() > 1) {
+        if (query.from_rack) {
+          query.rack[top.blank ? Query::BLANKS : word.back() - 'a']++;
+          tiles++;
+        }
+        word.pop_back();
+      }
+      path.pop_back();
+      continue;
+    }
+
+    char letter = top.child->first;
+    const TrieNode *child = top.child->second.get();
+    top.child++;
+    uint64_t slots = advance(top.slots, letter);
+    if (slots == 0 || tiles == 0 || !fits(slots, child, tiles - 1)) {
+      continue;
+    }
+    bool blank = false;
+    if (query.from_rack) {
+      // a tile of the letter is never worse to use than a blank
+      uint8_t &held = query.rack[letter - 'a'];
+      blank = held == 0;
+      if (blank && query.rack[Query::BLANKS] == 0) {
+        continue;
+      }
+      (blank ? query.rack[Query::BLANKS] : held)--;
+      tiles--;
+    }
+
+    word.push_back(letter);
+    path.push_back({child, child->nexts.begin(), slots, blank});
+    if (child->is_final && (slots >> query.slots.size() & 1)) {
+      count++;
+      found = word;
+      return true;
     }
-    cur = cur->nexts.find(letter)->second;
   }
-  cur->is_final = true;
+  return false;
 }
 
 // add all letters in cur->nexts to `nexts`
@@ -1,9 +1,12 @@
 #ifndef DICTIONARY_H
 #define DICTIONARY_H
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -15,6 +18,120 @@ public:
     // in the dictionary
     bool is_final = false;
     std::map<char, std::shared_ptr<TrieNode>> nexts;
+    // numbers the nodes from 0 to get_node_count() - 1, so that callers can
+    // keep their own per-node data in a vector
+    uint32_t id = 0;
+    // filled in once every word is read: the number of words at or below
+    // this node, and the fewest and most letters after it that spell one
+    uint32_t words = 0;
+    uint8_t min_length = 0;
+    uint8_t max_length = 0;
+  };
+
+  /*
+  A question about which words there are, answered by Dictionary::query.
+
+  slots: what each letter of a word may be, in order, as a mask with bit 0
+      for 'a'; ANY_LETTERS stands for any number of letters, as * does in a
+      pattern. At most MAX_SLOTS.
+  from_rack: whether words must be spelled from the tiles of rack
+  rack: the number of tiles of each letter from 'a' to 'z', then of blanks,
+      which can be any letter
+  limit: the most words to find
+  */
+  struct Query {
+    static constexpr uint32_t ANY_LETTER = (1u << 26) - 1;
+    static constexpr uint32_t ANY_LETTERS = UINT32_MAX;
+    static constexpr size_t MAX_SLOTS = 63;
+    static constexpr size_t BLANKS = 26;
+
+    std::vector<uint32_t> slots;
+    bool from_rack = false;
+    uint8_t rack[BLANKS + 1] = {0};
+    size_t limit = SIZE_MAX;
+
+    /*
+    Returns the query for a pattern of letters, ? for any one letter, * for
+    any number of letters and [...] for any one of the letters in brackets,
+    such as c?t* or [bc]at. Throws a CommandException if text is not one.
+    */
+    static Query pattern(std::string_view text);
+
+    /*
+    Returns the query for the words spelled by every tile of rack, which is
+    written as its letters with ? for each blank. Throws a CommandException
+    if rack holds anything else.
+    */
+    static Query anagrams(std::string_view rack);
+
+    /*
+    Keeps to the words spelled by some of the tiles of rack, written as for
+    anagrams.
+    */
+    void set_rack(std::string_view rack);
+  };
+
+  /*
+  The words a Query matches, found one at a time as they are asked for, in
+  alphabetical order. Only the path to the last word found is kept, so a
+  query matching most of the lexicon costs no more memory than one matching
+  a single word, and stopping early costs nothing for the words not asked
+  for.
+
+  The trie is walked with the set of slots each prefix can have reached, so
+  each word is found once however many ways it matches. A subtree is left
+  out as soon as no slot is reached, its words are all too short or too long
+  for the slots left, or the rack has too few tiles for them.
+
+  A Matches must not outlive its Dictionary.
+  */
+  class Matches {
+  public:
+    /*
+    Sets word to the next match and returns true, or returns false once
+    there are no more or limit have been found.
+    */
+    bool next(std::string &word);
+
+    // Returns the number of words found so far.
+    size_t get_count() const { return count; }
+
+  private:
+    friend class Dictionary;
+
+    /*
+    A node on the path to the last word found.
+
+    child: the next of its nexts to try
+    slots: the slots reached, bit i set if slot i is next
+    blank: whether the letter leading to it was spelled with a blank
+    */
+    struct Frame {
+      const TrieNode *node;
+      std::map<char, std::shared_ptr<TrieNode>>::const_iterator child;
+      uint64_t slots;
+      bool blank;
+    };
+
+    Matches(const TrieNode *root, const Query &query);
+
+    // Returns slots with every slot after a run of ANY_LETTERS added.
+    uint64_t close(uint64_t slots) const;
+    // Returns the slots reached from slots by one more letter.
+    uint64_t advance(uint64_t slots, char letter) const;
+    // Returns whether some word below node has as many letters after it as
+    // one of slots needs, and no more than most.
+    bool fits(uint64_t slots, const TrieNode *node, size_t most) const;
+
+    Query query;
+    // per slot, the letters needed from it on and whether any number more
+    // can follow
+    std::vector<uint8_t> fewest;
+    std::vector<bool> open;
+    size_t tiles;
+    std::vector<Frame> path;
+    std::string word;
+    size_t count;
   };
 
   /*
@@ -25,9 +142,45 @@ public:
   static Dictionary read(const std::string &file_path);
 
   /*
-  Returns whether `word` is in the dictionary or not.
+  Creates the same dictionary as read, on up to `threads` threads. The file
+  is read in one go and its words split by first letter, and by last letter
+  for the reversed trie. The subtrie of each letter is built by whichever
+  thread is free next, and then hung under its root.
+  */
+  static Dictionary read_parallel(const std::string &file_path,
+                                  size_t threads);
+
+  /*
+  Returns whether `word` is in the dictionary or not. Takes a view so that
+  words held in any kind of string can be checked without copying them.
+  */
+  bool is_word(std::string_view word) const;
+
+  /*
+  Sets results[i] to whether words[i] is in the dictionary for each of the
+  count words, and returns whether all of them are. The words are walked as
+  find_prefixes does.
   */
-  bool is_word(const std::string &word) const;
+  bool check_words(const std::string_view *words, size_t count,
+                   bool *results) const;
+
+  // Returns whether every word is in the dictionary, checked as check_words
+  // does.
+  bool all_words(const std::vector<std::string> &words) const;
+
+  /*
+  Sets nodes[i] to the node of prefixes[i], or nullptr if no word starts with
+  it, for each of the count prefixes. The trie walks of up to MAX_BATCH_WALKS
+  prefixes go in lockstep, a letter of each in turn, over a flat copy of the
+  trie whose nodes are found by index rather than through a map, and each
+  step prefetches the entry it moves to. While one walk waits for its next
+  entry to come from memory the others proceed, and by the time its turn comes
+  again the entry is usually in cache.
+  */
+  void find_prefixes(const std::string_view *prefixes, size_t count,
+                     const TrieNode **nodes) const;
+
+  static constexpr size_t MAX_BATCH_WALKS = 16;
 
   /*
   This function returns a vector of letters that could possibly follow prefix.
@@ -38,6 +191,61 @@ public:
   std::vector<char>
   next_letters(const std::string &prefix) const; // Used for testing
 
+  /*
+  Returns every word spelled by exactly the letters in `letters` plus
+  `blanks` letters of any kind, so that a rack can be checked for bingos
+  without walking the trie. Only words of MIN_ANAGRAM_LENGTH to
+  MAX_ANAGRAM_LENGTH letters are indexed; other lengths find nothing.
+  */
+  std::vector<std::string> find_anagrams(std::string letters,
+                                         size_t blanks) const;
+
+  static constexpr size_t MIN_ANAGRAM_LENGTH = 7;
+  static constexpr size_t MAX_ANAGRAM_LENGTH = 8;
+
+  /*
+  Returns the words query matches, found as Matches::next asks for them.
+  */
+  Matches query(const Query &query) const;
+
+  /*
+  Returns a hash of the words read, in the order they were read, so that data
+  built for one word list can tell it apart from another.
+  */
+  uint64_t get_hash() const { return hash; }
+
+  /*
+  Returns the number of words in the dictionary.
+  */
+  size_t get_word_count() const { return root->words; }
+
+  /*
+  Returns an estimate of the bytes the dictionary holds: its nodes, the map
+  entries linking them, the flat copy find_prefixes walks and the anagram
+  index. What the allocator adds to each block is left out.
+  */
+  size_t get_memory_usage() const;
+
+  /*
+  Returns the word at index in alphabetical order, for index below
+  get_word_count(), so that words can be sampled at random. Walks down from
+  the root by the word counts of the nodes, without visiting other words.
+  */
+  std::string word_at(size_t index) const;
+
+  /*
+  Returns the letters that can join before and after into a word, as a mask
+  with bit 0 for 'a'. With before empty these are the letters the word after
+  can be hooked by in front, found by one walk of the reversed trie; with
+  after empty, those it can be hooked by behind.
+  */
+  uint32_t cross_letters(std::string_view before, std::string_view after) const;
+
+  /*
+  Returns the number of nodes in both tries, roots included.
+  */
+  size_t get_node_count() const { return node_count; }
+
   /*
   Returns root
   */
@@ -58,10 +266,70 @@ public:
   std::shared_ptr<TrieNode>
   find_prefix(const std::string &prefix) const; // Used for testing
 
+  /*
+  Returns the root of the reversed trie, which holds every word spelled back
+  to front, so that a word can be walked from its last letter to its first.
+  */
+  std::shared_ptr<TrieNode> get_reversed_root() const {
+    return reversed_root;
+  };
+
+  /*
+  Returns the node of the reversed trie reached by walking suffix from its
+  last letter to its first, or nullptr if no word ends with suffix. The
+  letters of its `nexts` are those that can come before suffix.
+  */
+  std::shared_ptr<TrieNode> find_suffix(const std::string &suffix) const;
+
 private:
   std::shared_ptr<TrieNode> root;
+  std::shared_ptr<TrieNode> reversed_root;
+  size_t node_count = 0;
+  uint64_t hash = 0;
+  // indexed words by their letters in sorted order
+  using AnagramIndex =
+      std::unordered_map<std::string, std::vector<std::string>>;
+  AnagramIndex anagrams;
+
+  /*
+  A node of the forward trie packed for find_prefixes, so that a walk reads
+  one small entry per letter instead of searching a map.
+
+  letters: the letters it has children for, as a mask with bit 0 for an
+      apostrophe and bits 1 to 26 for 'a' to 'z', and FINAL_BIT if it ends a
+      word
+  first_child: the index in `flat` of the child of its lowest letter; the
+      others follow it in letter order
+  node: the TrieNode it stands for
+  */
+  struct FlatNode {
+    static constexpr uint32_t FINAL_BIT = 1u << 31;
+
+    uint32_t letters;
+    uint32_t first_child;
+    const TrieNode *node;
+  };
+  // the forward trie with every node's children side by side and each
+  // subtrie after its root's, or empty if a word has a letter no bit is for
+  std::vector<FlatNode> flat;
+
+  static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+  // Fills `flat` from the forward trie.
+  void flatten();
+  // Appends the children of flat[index] to `flat`, then theirs in turn.
+  bool flatten_children(uint32_t index);
+  // Sets indices[i] to the index in `flat` of prefixes[i], or NO_NODE, for
+  // up to MAX_BATCH_WALKS prefixes walked in lockstep.
+  void walk_flat(const std::string_view *prefixes, size_t count,
+                 uint32_t *indices) const;
 
-  void add_word(const std::string &word);
+  static void add_anagram(AnagramIndex &anagrams, const std::string &word);
+  static void annotate(TrieNode *node, size_t first_id);
+  static void annotate_node(TrieNode *node);
+  void collect_anagrams(const std::string &letters, size_t blanks,
+                        char first_blank,
+                        std::vector<std::string> &words) const;
 };
 
 #endif
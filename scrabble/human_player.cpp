@@ -1,4 +1,5 @@
 #include "human_player.h"
+#include "computer_player.h"
 #include "exceptions.h"
 #include "formatting.h"
 #include "move.h"
@@ -42,8 +43,8 @@ Move HumanPlayer::get_move(const Board &board,
   while (1) {
     // handle/parse user input
     try {
-      cout << "Your move, options include: PASS, EXCHANGE (tiles), or PLACE ( "
-              "- or |, row, column, tiles) "
+      cout << "Your move, options include: PASS, EXCHANGE (tiles), PLACE ( "
+              "- or |, row, column, tiles), or HINT "
            << endl;
       // retrieve entire user command
       getline(cin, raw_line);
@@ -58,7 +59,10 @@ Move HumanPlayer::get_move(const Board &board,
       ss >> input;
 
       //  check for equality operator that ignores case if possible
-      if (input == "PASS") {
+      if (input == "HINT") {
+        print_hints(board, dictionary, cout);
+        continue;
+      } else if (input == "PASS") {
         Move valid_move = Move();
         return valid_move;
       } else if (input == "EXCHANGE") {
@@ -71,7 +75,7 @@ Move HumanPlayer::get_move(const Board &board,
                 try {
                     ss >> input;
                     while(count < input.size()){
-                        to_tile = new TileKind(this->hand_tiles.lookup_tile(input[count]));
+                        to_tile = new TileKind(this->tiles.lookup_tile(input[count]));
                         tiles_leaving.push_back(*to_tile);
                         count++;
                     }
@@ -132,7 +136,7 @@ Move HumanPlayer::get_move(const Board &board,
                   while(count < input.size()){
                       
                       // instantiate tile object from input char, then push onto place vector<tile>
-                      to_tile = new TileKind(this->hand_tiles.lookup_tile(input[count]));
+                      to_tile = new TileKind(this->tiles.lookup_tile(input[count]));
                       
                       // assign the next char in input stream to blank tile, then increment twice
                       if(input[count] == '?'){
@@ -165,7 +169,7 @@ Move HumanPlayer::get_move(const Board &board,
             // assess via test_place if placement on board holds
                 PlaceResult PR = board.test_place(valid_move);
             if (PR.valid){
-                if(!dictionary.is_word(PR.words[0])){
+                if(!dictionary.all_words(PR.words)){
                     throw MoveException("Word not in dictionary :/");
                 }
             return valid_move;
@@ -198,12 +202,81 @@ Move HumanPlayer::get_move(const Board &board,
 }
 
 vector<TileKind> HumanPlayer::parse_tiles(string &letters) const {
-  // TODO: begin implementation here.
+  vector<TileKind> parsed;
+  for (size_t i = 0; i < letters.size(); i++) {
+    // throws out_of_range when the letter is not in hand
+    TileKind tile = this->tiles.lookup_tile(letters[i]);
+    // a blank is followed by the letter it stands for
+    if (letters[i] == TileKind::BLANK_LETTER && i + 1 < letters.size()) {
+      tile.assigned = letters[++i];
+    }
+    parsed.push_back(tile);
+  }
+  return parsed;
 }
 
 Move HumanPlayer::parse_move(string &move_string) const {
-  // TODO: begin implementation here.
+  stringstream ss(move_string);
+  string kind;
+  ss >> kind;
+  to_upper(kind);
+
+  if (kind == "PASS") {
+    return Move();
+  } else if (kind == "EXCHANGE") {
+    string letters;
+    ss >> letters;
+    return Move(parse_tiles(letters));
+  } else if (kind == "PLACE") {
+    string dir;
+    size_t row = 0;
+    size_t column = 0;
+    string letters;
+    if (!(ss >> dir >> row >> column >> letters) || row == 0 || column == 0 ||
+        (dir != "-" && dir != "|")) {
+      throw CommandException("Invalid Place. Use: PLACE - or | row column tiles");
+    }
+    Direction direction = dir == "-" ? Direction::ACROSS : Direction::DOWN;
+    return Move(parse_tiles(letters), row - 1, column - 1, direction);
+  }
+  throw CommandException("Unknown command: " + kind);
 }
+// Prints the best few moves for the current hand as PLACE commands.
+void HumanPlayer::print_hints(const Board &board, const Dictionary &dictionary,
+                              ostream &out) const {
+  ComputerPlayer advisor(this->get_name(), this->get_hand_size());
+  advisor.add_tiles(this->tiles.get_tiles());
+  vector<RankedMove> hints =
+      advisor.get_top_moves(board, dictionary, HINT_COUNT);
+
+  if (hints.empty()) {
+    out << "No moves found, consider an EXCHANGE or PASS." << endl;
+    return;
+  }
+  for (size_t i = 0; i < hints.size(); i++) {
+    const Move &move = hints[i].move;
+    out << i + 1 << ". PLACE "
+        << (move.direction == Direction::ACROSS ? "-" : "|") << " "
+        << move.row + 1 << " " << move.column + 1 << " ";
+    for (const TileKind &tile : move.tiles) {
+      out << tile.letter;
+      if (tile.letter == TileKind::BLANK_LETTER) {
+        out << tile.assigned;
+      }
+    }
+    out << " (" << SCORE_COLOR << hints[i].points << rang::style::reset
+        << " points; words:";
+    for (const string &word : hints[i].words) {
+      out << " " << word;
+    }
+    out << "; leave: ";
+    for (const TileKind &tile : hints[i].leave) {
+      out << tile.letter;
+    }
+    out << ")" << endl;
+  }
+}
+
 bool HumanPlayer::is_human() const{
     return true;
 }
@@ -231,7 +304,7 @@ void HumanPlayer::print_hand(ostream &out) const {
   for (size_t line = 0; line < SQUARE_INNER_HEIGHT; ++line) {
     out << FG_COLOR_LABEL << BG_COLOR_OUTSIDE_BOARD
         << repeat(SPACE, HAND_LEFT_MARGIN);
-    for (auto it = this->hand_tiles.cbegin(); it != this->hand_tiles.cend();
+    for (auto it = this->tiles.cbegin(); it != this->tiles.cend();
          ++it) {
       out << FG_COLOR_LINE << BG_COLOR_NORMAL_SQUARE << I_VERTICAL
           << BG_COLOR_PLAYER_HAND;
@@ -18,10 +18,14 @@ public:
     Move get_move(const Board& board, const Dictionary& dictionary) const override;
     
     bool is_human() const;
+
+    // Number of moves suggested by the HINT command
+    static const size_t HINT_COUNT = 3;
 private:
     Move parse_move(std::string& move_string) const;
     std::vector<TileKind> parse_tiles(std::string& letters) const;
     void print_hand(std::ostream& out) const;
+    void print_hints(const Board& board, const Dictionary& dictionary, std::ostream& out) const;
 };
 
 #endif
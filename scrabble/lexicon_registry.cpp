@@ -0,0 +1,64 @@
+#include "lexicon_registry.h"
+#include "exceptions.h"
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+LexiconRegistry &LexiconRegistry::instance() {
+  static LexiconRegistry registry;
+  return registry;
+}
+
+void LexiconRegistry::add(const string &name, const string &file_path) {
+  lock_guard<mutex> guard(lock);
+  unique_ptr<Entry> &entry = entries[name];
+  if (entry == nullptr) {
+    entry.reset(new Entry());
+    entry->file_path = file_path;
+  } else if (entry->file_path != file_path) {
+    throw FileException("lexicon " + name + " is already " + entry->file_path);
+  }
+}
+
+shared_ptr<const Dictionary> LexiconRegistry::get(const string &name) {
+  Entry *entry;
+  {
+    lock_guard<mutex> guard(lock);
+    auto found = entries.find(name);
+    if (found == entries.end()) {
+      throw FileException("no lexicon named " + name);
+    }
+    // entries are never removed, so entry outlives the lock
+    entry = found->second.get();
+  }
+
+  // a read that throws leaves the flag unset, so the next get tries again
+  call_once(entry->read, [&]() {
+    size_t threads = max(thread::hardware_concurrency(), 1u);
+    shared_ptr<const Dictionary> dictionary = make_shared<const Dictionary>(
+        Dictionary::read_parallel(entry->file_path, threads));
+    lock_guard<mutex> guard(lock);
+    entry->dictionary = dictionary;
+  });
+  return entry->dictionary;
+}
+
+vector<LexiconRegistry::Usage> LexiconRegistry::get_usage() const {
+  vector<Usage> usage;
+  lock_guard<mutex> guard(lock);
+  for (const auto &entry : entries) {
+    Usage lexicon;
+    lexicon.name = entry.first;
+    lexicon.file_path = entry.second->file_path;
+    const shared_ptr<const Dictionary> &dictionary = entry.second->dictionary;
+    if (dictionary != nullptr) {
+      lexicon.loaded = true;
+      lexicon.words = dictionary->get_word_count();
+      lexicon.nodes = dictionary->get_node_count();
+      lexicon.bytes = dictionary->get_memory_usage();
+    }
+    usage.push_back(lexicon);
+  }
+  return usage;
+}
@@ -0,0 +1,71 @@
+#ifndef LEXICON_REGISTRY_H
+#define LEXICON_REGISTRY_H
+
+#include "dictionary.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+The lexicons a process can use, by name, so that every game using the same
+word list shares one copy of its tries however many games run and on however
+many threads. A lexicon is read the first time it is asked for and then kept
+for as long as the registry lives. The dictionaries handed out are const, so
+any number of threads can read one at once.
+*/
+class LexiconRegistry {
+public:
+  // Returns the registry shared by the whole process.
+  static LexiconRegistry &instance();
+
+  /*
+  Names the lexicon in file_path, without reading it. Naming a lexicon again
+  with the same file does nothing. Throws a FileException if name already
+  names another file.
+  */
+  void add(const std::string &name, const std::string &file_path);
+
+  /*
+  Returns the lexicon called name, reading it on its first use. Threads that
+  ask for a lexicon while it is being read wait for it instead of reading it
+  again. Throws a FileException if no lexicon has the name or its file cannot
+  be read.
+  */
+  std::shared_ptr<const Dictionary> get(const std::string &name);
+
+  /*
+  What one lexicon holds.
+
+  name, file_path: as added
+  loaded: whether it has been read; the counts are zero until it is
+  words: number of words
+  nodes: number of trie nodes
+  bytes: an estimate of its memory, as Dictionary::get_memory_usage gives it
+  */
+  struct Usage {
+    std::string name;
+    std::string file_path;
+    bool loaded = false;
+    size_t words = 0;
+    size_t nodes = 0;
+    size_t bytes = 0;
+  };
+
+  // Returns the usage of every lexicon, in order of name.
+  std::vector<Usage> get_usage() const;
+
+private:
+  struct Entry {
+    std::string file_path;
+    std::once_flag read;
+    std::shared_ptr<const Dictionary> dictionary;
+  };
+
+  mutable std::mutex lock;
+  std::map<std::string, std::unique_ptr<Entry>> entries;
+};
+
+#endif
@@ -0,0 +1,255 @@
+#include "opening_book.h"
+#include "computer_player.h"
+#include "exceptions.h"
+#include "packed_move.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+static const char BOOK_MAGIC[8] = {'S', 'C', 'R', 'B', 'O', 'O', 'K', '\0'};
+static const uint32_t BOOK_VERSION = 1;
+
+// bits each tile takes in a rack key
+static const size_t KEY_BITS = 5;
+
+// FNV-1a, 64 bit
+static const uint64_t HASH_OFFSET = 14695981039346656037ull;
+static const uint64_t HASH_PRIME = 1099511628211ull;
+
+struct OpeningBook::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_size;
+  uint64_t board_hash;
+  uint64_t lexicon_hash;
+  uint64_t slot_count;
+  uint64_t entry_count;
+};
+
+static uint64_t hash_value(uint64_t hash, uint64_t value) {
+  for (size_t i = 0; i < sizeof(value); i++) {
+    hash = (hash ^ ((value >> (8 * i)) & 0xff)) * HASH_PRIME;
+  }
+  return hash;
+}
+
+// the slot a key's probe starts at
+static size_t home_slot(uint64_t key, uint64_t slot_count) {
+  uint64_t mixed = key * 0x9e3779b97f4a7c15ull;
+  return (mixed ^ (mixed >> 32)) % slot_count;
+}
+
+uint64_t OpeningBook::rack_key(const TileCollection &rack) {
+  vector<uint64_t> codes;
+  for (const TileKind &tile : rack.get_tiles()) {
+    size_t kind = PackedRack::index(tile.letter);
+    if (kind >= PackedRack::KINDS) {
+      return NO_RACK;
+    }
+    // blanks sort last
+    codes.push_back(kind + 1);
+  }
+  if (codes.empty() || codes.size() > MAX_TILES) {
+    return NO_RACK;
+  }
+  sort(codes.begin(), codes.end());
+
+  uint64_t key = 0;
+  for (uint64_t code : codes) {
+    key = key << KEY_BITS | code;
+  }
+  return key;
+}
+
+uint64_t OpeningBook::board_hash(const Board &board) {
+  uint64_t hash = HASH_OFFSET;
+  hash = hash_value(hash, board.rows);
+  hash = hash_value(hash, board.columns);
+  hash = hash_value(hash, board.start.row);
+  hash = hash_value(hash, board.start.column);
+  for (size_t row = 0; row < board.rows; row++) {
+    for (size_t column = 0; column < board.columns; column++) {
+      const BoardSquare &square = board.square_at(Board::Position(row, column));
+      hash = hash_value(hash, square.letter_multiplier);
+      hash = hash_value(hash, square.word_multiplier);
+    }
+  }
+  return hash;
+}
+
+vector<OpeningBook::Entry>
+OpeningBook::generate(const Board &board, const Dictionary &dictionary,
+                      const vector<vector<TileKind>> &racks, size_t hand_size,
+                      size_t threads) {
+  vector<Entry> entries(racks.size());
+  atomic<size_t> next(0);
+
+  // each thread takes the next rack no other thread has taken
+  auto work = [&]() {
+    ComputerPlayer player("book", hand_size);
+    // no two racks share an anchor, so cached moves would never be used
+    player.set_move_cache(false);
+    for (size_t i = next++; i < racks.size(); i = next++) {
+      Entry &entry = entries[i];
+      memset(&entry, 0, sizeof(entry));
+      TileCollection rack;
+      for (const TileKind &tile : racks[i]) {
+        rack.add_tile(tile);
+      }
+      entry.key = rack_key(rack);
+      if (entry.key == NO_RACK) {
+        continue;
+      }
+
+      player.add_tiles(racks[i]);
+      vector<RankedMove> best = player.get_top_moves(board, dictionary, 1);
+      player.remove_tiles(racks[i]);
+      if (best.empty()) {
+        continue;
+      }
+
+      const Move &move = best[0].move;
+      PackedMove packed(move.row, move.column, move.direction);
+      for (const TileKind &tile : move.tiles) {
+        packed.push(tile);
+      }
+      entry.points = best[0].points;
+      entry.row = packed.row;
+      entry.column = packed.column;
+      entry.direction = move.direction == Direction::DOWN;
+      entry.length = packed.length;
+      copy(packed.tiles, packed.tiles + packed.length, entry.tiles);
+    }
+  };
+
+  vector<thread> workers;
+  for (size_t i = 1; i < threads; i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (thread &worker : workers) {
+    worker.join();
+  }
+
+  entries.erase(remove_if(entries.begin(), entries.end(),
+                          [](const Entry &entry) {
+                            return entry.key == NO_RACK;
+                          }),
+                entries.end());
+  return entries;
+}
+
+void OpeningBook::write(const string &file_path, uint64_t board_hash,
+                        uint64_t lexicon_hash, const vector<Entry> &entries) {
+  // open addressing at no more than 80% full
+  uint64_t slot_count = entries.size() + entries.size() / 4 + 1;
+  vector<Entry> slots(slot_count);
+  memset(slots.data(), 0, slots.size() * sizeof(Entry));
+  uint64_t entry_count = 0;
+  for (const Entry &entry : entries) {
+    size_t slot = home_slot(entry.key, slot_count);
+    while (slots[slot].key != NO_RACK && slots[slot].key != entry.key) {
+      slot = (slot + 1) % slot_count;
+    }
+    if (slots[slot].key == NO_RACK) {
+      entry_count++;
+    }
+    slots[slot] = entry;
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+  header.version = BOOK_VERSION;
+  header.entry_size = sizeof(Entry);
+  header.board_hash = board_hash;
+  header.lexicon_hash = lexicon_hash;
+  header.slot_count = slot_count;
+  header.entry_count = entry_count;
+
+  ofstream file(file_path, ios::binary | ios::trunc);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(slots.data()),
+             slots.size() * sizeof(Entry));
+  if (!file) {
+    throw FileException("cannot write opening book file!");
+  }
+}
+
+shared_ptr<const OpeningBook> OpeningBook::open(const string &file_path) {
+  int fd = ::open(file_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw FileException("cannot open opening book file!");
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 ||
+      static_cast<size_t>(status.st_size) < sizeof(Header)) {
+    close(fd);
+    throw FileException("invalid opening book file!");
+  }
+  size_t size = status.st_size;
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw FileException("cannot map opening book file!");
+  }
+
+  // the book owns the mapping from here on, so it is unmapped if invalid
+  shared_ptr<const OpeningBook> book(new OpeningBook(mapping, size));
+  const Header &header = *book->header;
+  if (memcmp(header.magic, BOOK_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != BOOK_VERSION || header.entry_size != sizeof(Entry) ||
+      header.slot_count == 0 ||
+      header.slot_count != (size - sizeof(Header)) / sizeof(Entry) ||
+      (size - sizeof(Header)) % sizeof(Entry) != 0) {
+    throw FileException("invalid opening book file!");
+  }
+  return book;
+}
+
+OpeningBook::OpeningBook(void *mapping, size_t size)
+    : mapping(mapping), size(size),
+      header(static_cast<const Header *>(mapping)),
+      slots(reinterpret_cast<const Entry *>(header + 1)) {}
+
+OpeningBook::~OpeningBook() { munmap(mapping, size); }
+
+bool OpeningBook::matches(const Board &board,
+                          const Dictionary &dictionary) const {
+  return header->lexicon_hash == dictionary.get_hash() &&
+         header->board_hash == board_hash(board);
+}
+
+const OpeningBook::Entry *OpeningBook::find(uint64_t key) const {
+  if (key == NO_RACK) {
+    return nullptr;
+  }
+  size_t slot = home_slot(key, header->slot_count);
+  for (size_t probes = 0;
+       probes < header->slot_count && slots[slot].key != NO_RACK; probes++) {
+    if (slots[slot].key == key) {
+      return &slots[slot];
+    }
+    slot = (slot + 1) % header->slot_count;
+  }
+  return nullptr;
+}
+
+void OpeningBook::unpack(const Entry &entry, const TileCollection &rack,
+                         Move &move) {
+  PackedMove packed(entry.row, entry.column,
+                    entry.direction ? Direction::DOWN : Direction::ACROSS);
+  packed.length = min<size_t>(entry.length, MAX_TILES);
+  copy(entry.tiles, entry.tiles + packed.length, packed.tiles);
+  packed.unpack(rack, move);
+}
+
+size_t OpeningBook::get_entry_count() const { return header->entry_count; }
@@ -0,0 +1,114 @@
+#ifndef OPENING_BOOK_H
+#define OPENING_BOOK_H
+
+#include "board.h"
+#include "dictionary.h"
+#include "move.h"
+#include "tile_collection.h"
+#include "tile_kind.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+The best first move for every rack a hand can hold, so that the opening of a
+game is a table lookup instead of a search. A book is built offline by the
+scrabble-book tool and read back through a memory map: opening one reads
+nothing until a rack is looked up, and every process using the same book
+shares its pages.
+
+Racks are keyed by their letters in sorted order and their number of blanks.
+A book records hashes of the board layout and the word list it was built for,
+and is only used with the same ones.
+*/
+class OpeningBook {
+public:
+  static constexpr size_t MAX_TILES = 10;
+
+  /*
+  The move for one rack, as stored in the file.
+
+  key: the rack's key, or NO_RACK for an empty slot
+  points: what the move scores, empty hand bonus included
+  row, column, direction: where the move starts and its Direction
+  length: number of tiles placed; zero if the rack can only pass
+  tiles: the letters placed, blanks as in PackedMove
+  */
+  struct Entry {
+    uint64_t key;
+    uint16_t points;
+    uint8_t row;
+    uint8_t column;
+    uint8_t direction;
+    uint8_t length;
+    unsigned char tiles[MAX_TILES];
+  };
+
+  static const uint64_t NO_RACK = 0;
+
+  /*
+  Returns the key of a rack: five bits per tile, in sorted order with blanks
+  last. Returns NO_RACK for an empty rack, one of more than MAX_TILES tiles or
+  one with a tile no key can hold.
+  */
+  static uint64_t rack_key(const TileCollection &rack);
+
+  /*
+  Returns a hash of a board's size, start square and multipliers. The tiles on
+  it are left out.
+  */
+  static uint64_t board_hash(const Board &board);
+
+  /*
+  Finds the best opening move for every rack on an empty board, on up to
+  `threads` threads each with its own ComputerPlayer. Racks are given as the
+  tiles drawn, of any hand size up to MAX_TILES.
+  */
+  static std::vector<Entry>
+  generate(const Board &board, const Dictionary &dictionary,
+           const std::vector<std::vector<TileKind>> &racks, size_t hand_size,
+           size_t threads);
+
+  /*
+  Writes entries as a book for the given board and word list hashes. Throws a
+  FileException if the file cannot be written.
+  */
+  static void write(const std::string &file_path, uint64_t board_hash,
+                    uint64_t lexicon_hash, const std::vector<Entry> &entries);
+
+  /*
+  Maps a book written by write() into memory. Throws a FileException if the
+  file cannot be read or is not a book.
+  */
+  static std::shared_ptr<const OpeningBook> open(const std::string &file_path);
+
+  ~OpeningBook();
+  OpeningBook(const OpeningBook &) = delete;
+  OpeningBook &operator=(const OpeningBook &) = delete;
+
+  // Returns whether the book was built for this board layout and word list.
+  bool matches(const Board &board, const Dictionary &dictionary) const;
+
+  // Returns the entry for a rack key, or nullptr if the book has none.
+  const Entry *find(uint64_t key) const;
+
+  // Fills move with an entry's placement, its tiles taken from rack.
+  static void unpack(const Entry &entry, const TileCollection &rack,
+                     Move &move);
+
+  size_t get_entry_count() const;
+
+private:
+  struct Header;
+
+  OpeningBook(void *mapping, size_t size);
+
+  void *mapping;
+  size_t size;
+  const Header *header;
+  const Entry *slots;
+};
+
+#endif
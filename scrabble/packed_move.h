@@ -0,0 +1,139 @@
+#ifndef PACKED_MOVE_H
+#define PACKED_MOVE_H
+
+#include "move.h"
+#include "tile_collection.h"
+#include "tile_kind.h"
+#include <cstdint>
+
+
+// Fixed-size values used by the move search in place of Move and
+// TileCollection, converted back at the ComputerPlayer API boundary.
+
+// A placement of up to MAX_TILES tiles in a fixed-size value, so that the move
+// search can copy and store moves without allocating. Each tile is its
+// letter, with BLANK_FLAG set if it is a blank standing for that letter (or
+// just BLANK_FLAG while the search has not chosen one yet). Tile points are
+// not stored; they are looked up in the rack the move was made from when
+// converting back to a Move.
+//
+// A move marked as an alternative places the same tiles on the same squares
+// as the one before it, with its blanks standing for other letters.
+struct PackedMove {
+    static constexpr size_t MAX_TILES = 15;
+    static const unsigned char BLANK_FLAG = 0x80;
+
+    uint8_t row;
+    uint8_t column;
+    uint8_t length;
+    Direction direction;
+    bool alternative;
+    unsigned char tiles[MAX_TILES];
+
+    PackedMove(size_t row, size_t column, Direction direction)
+        : row(row)
+        , column(column)
+        , length(0)
+        , direction(direction)
+        , alternative(false) {}
+
+    bool full() const { return length == MAX_TILES; }
+
+    void push(const TileKind& tile) {
+        tiles[length++] = tile.letter == TileKind::BLANK_LETTER
+            ? static_cast<unsigned char>(tile.assigned) | BLANK_FLAG
+            : static_cast<unsigned char>(tile.letter);
+    }
+
+    void pop() { length--; }
+
+    // Fills move with this placement, reusing its tile storage.
+    void unpack(const TileCollection& rack, Move& move) const {
+        move.kind = MoveKind::PLACE;
+        move.row = row;
+        move.column = column;
+        move.direction = direction;
+        move.tiles.clear();
+        for (size_t i = 0; i < length; ++i) {
+            if (tiles[i] & BLANK_FLAG) {
+                TileKind blank = rack.lookup_tile(TileKind::BLANK_LETTER);
+                blank.assigned = tiles[i] & ~BLANK_FLAG;
+                move.tiles.push_back(blank);
+            } else {
+                move.tiles.push_back(rack.lookup_tile(tiles[i]));
+            }
+        }
+    }
+};
+
+
+// The tiles of a rack as a count per letter, so that the move search can take
+// tiles out and put them back without allocating.
+struct PackedRack {
+    static const size_t KINDS = 27;  // a to z, then the blank
+    static const size_t BLANK = 26;
+
+    uint8_t counts[KINDS];
+    unsigned short points[KINDS];
+    size_t size;
+    unsigned int total;
+
+    explicit PackedRack(const TileCollection& rack)
+        : size(0)
+        , total(0) {
+        for (size_t i = 0; i < KINDS; ++i) {
+            counts[i] = 0;
+            points[i] = 0;
+        }
+        for (const TileKind& tile : rack.get_tiles()) {
+            size_t kind = index(tile.letter);
+            if (kind < KINDS) {
+                counts[kind]++;
+                points[kind] = tile.points;
+                size++;
+                total += tile.points;
+            }
+        }
+    }
+
+    // Returns the slot of a letter, or KINDS for letters no tile can have.
+    static size_t index(char letter) {
+        if (letter == TileKind::BLANK_LETTER) {
+            return BLANK;
+        }
+        return letter >= 'a' && letter <= 'z' ? letter - 'a' : KINDS;
+    }
+
+    // Returns the slot of a letter some tile has.
+    static size_t slot(char letter) {
+        return letter == TileKind::BLANK_LETTER ? BLANK : letter - 'a';
+    }
+
+    bool has(char letter) const {
+        size_t kind = index(letter);
+        return kind < KINDS && counts[kind] > 0;
+    }
+
+    TileKind lookup_tile(char letter) const {
+        return TileKind(letter, points[index(letter)]);
+    }
+
+    // tile must be one the rack has
+    void remove_tile(const TileKind& tile) {
+        counts[slot(tile.letter)]--;
+        size--;
+        total -= tile.points;
+    }
+
+    // tile must be one taken from the rack
+    void add_tile(const TileKind& tile) {
+        counts[slot(tile.letter)]++;
+        size++;
+        total += tile.points;
+    }
+
+    size_t count_tiles() const { return size; }
+    unsigned int total_points() const { return total; }
+};
+
+#endif
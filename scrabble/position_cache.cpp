@@ -0,0 +1,57 @@
+#include "position_cache.h"
+#include <functional>
+
+using namespace std;
+
+PositionCache::PositionCache(size_t capacity) : capacity(capacity) {}
+
+bool PositionCache::find(const string &key, vector<RankedMove> &moves) {
+  size_t hash = std::hash<string>()(key);
+  lock_guard<mutex> guard(lock);
+  auto found = index.find(hash);
+  if (found == index.end() || found->second->key != key) {
+    stats.misses++;
+    return false;
+  }
+  // move the entry to the front: it is now the most recently used
+  entries.splice(entries.begin(), entries, found->second);
+  moves = found->second->moves;
+  stats.hits++;
+  return true;
+}
+
+void PositionCache::insert(const string &key, const vector<RankedMove> &moves) {
+  if (capacity == 0) {
+    return;
+  }
+  size_t hash = std::hash<string>()(key);
+  lock_guard<mutex> guard(lock);
+  auto found = index.find(hash);
+  if (found != index.end()) {
+    found->second->key = key;
+    found->second->moves = moves;
+    entries.splice(entries.begin(), entries, found->second);
+    return;
+  }
+
+  if (entries.size() == capacity) {
+    index.erase(entries.back().hash);
+    entries.pop_back();
+    stats.evictions++;
+  }
+  entries.push_front({hash, key, moves});
+  index[hash] = entries.begin();
+}
+
+void PositionCache::clear() {
+  lock_guard<mutex> guard(lock);
+  entries.clear();
+  index.clear();
+}
+
+PositionCache::Stats PositionCache::get_stats() const {
+  lock_guard<mutex> guard(lock);
+  Stats current = stats;
+  current.entries = entries.size();
+  return current;
+}
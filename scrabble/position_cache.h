@@ -0,0 +1,71 @@
+#ifndef POSITION_CACHE_H
+#define POSITION_CACHE_H
+
+#include "ranked_move.h"
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+The moves found for whole positions, so that a position asked about again
+is answered without searching. Any number of players on any number of
+threads can share one cache. It holds at most `capacity` positions and
+evicts the least recently used one to make room.
+
+Positions are looked up by a hash of their key, and the full key is compared
+before an entry is used, so two positions whose hashes collide never share
+moves.
+*/
+class PositionCache {
+public:
+  explicit PositionCache(size_t capacity);
+
+  /*
+  Sets moves to the moves stored for key and returns true, or returns false
+  if there are none.
+  */
+  bool find(const std::string &key, std::vector<RankedMove> &moves);
+
+  /*
+  Stores moves for key, replacing any stored for it or for a key with the
+  same hash.
+  */
+  void insert(const std::string &key, const std::vector<RankedMove> &moves);
+
+  void clear();
+
+  /*
+  What the cache has done since it was created.
+
+  hits: lookups answered from the cache
+  misses: lookups that found nothing (or an entry for another key)
+  evictions: entries dropped to make room for others
+  entries: positions held now
+  */
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+  };
+  Stats get_stats() const;
+
+private:
+  struct Entry {
+    size_t hash;
+    std::string key;
+    std::vector<RankedMove> moves;
+  };
+
+  size_t capacity;
+  mutable std::mutex lock;
+  // most recently used first
+  std::list<Entry> entries;
+  std::unordered_map<size_t, std::list<Entry>::iterator> index;
+  Stats stats;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef RANKED_MOVE_H
+#define RANKED_MOVE_H
+
+#include "move.h"
+#include "tile_kind.h"
+#include <string>
+#include <vector>
+
+
+// A generated move together with what it would earn: points (including the
+// empty hand bonus), the words it forms and the tiles left in hand after it.
+struct RankedMove {
+    Move move;
+    unsigned int points;
+    std::vector<std::string> words;
+    std::vector<TileKind> leave;
+
+    RankedMove(const Move& move, unsigned int points, const std::vector<std::string>& words, const std::vector<TileKind>& leave)
+        : move(move)
+        , points(points)
+        , words(words)
+        , leave(leave) {}
+};
+
+#endif
@@ -7,13 +7,31 @@
 using namespace std;
 
 
+// Returns the config's lexicon, read once however many games in the process
+// use it: the one lexicon_name picks, or else the dictionary file.
+static shared_ptr<const Dictionary> load_lexicon(const ScrabbleConfig& config) {
+    LexiconRegistry& lexicons = LexiconRegistry::instance();
+    for (const auto& lexicon : config.lexicon_file_paths) {
+        lexicons.add(lexicon.first, lexicon.second);
+    }
+    if (config.lexicon_name.empty()) {
+        lexicons.add(config.dictionary_file_path, config.dictionary_file_path);
+        return lexicons.get(config.dictionary_file_path);
+    }
+    return lexicons.get(config.lexicon_name);
+}
+
 Scrabble::Scrabble(const ScrabbleConfig& config)
     : hand_size(config.hand_size)
     , minimum_word_length(config.minimum_word_length)
     , tile_bag(TileBag::read(config.tile_bag_file_path, config.seed))
     , board(Board::read(config.board_file_path))
-    , dictionary(Dictionary::read(config.dictionary_file_path)) {
+    , dictionary(load_lexicon(config)) {
         num_human_players = 0;
+        trace_file_path = config.trace_file_path;
+        if (!config.opening_book_file_path.empty()) {
+            opening_book = OpeningBook::open(config.opening_book_file_path);
+        }
     }
 
 
@@ -40,7 +58,9 @@ void Scrabble::add_players() {
         }
         cout << "Player " << i << ", named \"" << player_name << "\", has been added." << endl;
         if(is_CPU == 'Y'){
-            shared_ptr<Player> player = make_shared<ComputerPlayer>(player_name, hand_size);
+            shared_ptr<ComputerPlayer> computer = make_shared<ComputerPlayer>(player_name, hand_size);
+            computer->set_opening_book(opening_book);
+            shared_ptr<Player> player = computer;
             player->add_tiles(tile_bag.remove_random_tiles(this->hand_size));
             player->assign_human('N');
             players.push_back(player);
@@ -56,11 +76,14 @@ void Scrabble::add_players() {
 
 void Scrabble::game_loop() {
 	size_t sequential_passes = 0;
+	size_t turn = 0;
 
 	while (true) {
 		for (auto player : this->players) {
+            Trace::Span span("turn");
+            span.arg("turn", ++turn);
             board.print(cout);
-            Move move = player->get_move(board, dictionary);
+            Move move = player->get_move(board, *dictionary);
             sequential_passes = move.kind == MoveKind::PASS ? sequential_passes + 1 : 0;
 
 			if (move.kind == MoveKind::EXCHANGE) {
@@ -165,8 +188,12 @@ void Scrabble::print_result() {
 
 
 void Scrabble::main() {
-    add_players();
-    game_loop();
+    {
+        // stops the trace however the game ends
+        Trace::Session trace(trace_file_path);
+        add_players();
+        game_loop();
+    }
     final_subtraction(players);
     print_result();
 }
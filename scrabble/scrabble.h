@@ -10,7 +10,10 @@
 #include "scrabble_config.h"
 #include "rang.h"
 #include "move.h"
+#include "opening_book.h"
+#include "lexicon_registry.h"
 #include "colors.h"
+#include "trace.h"
 #include <cmath>
 #include <memory>
 
@@ -31,10 +34,12 @@ private:
     size_t hand_size;
     size_t minimum_word_length;
     size_t num_human_players;
+    std::string trace_file_path;
 
     TileBag tile_bag;
     Board board;
-    Dictionary dictionary;
+    std::shared_ptr<const Dictionary> dictionary;
+    std::shared_ptr<const OpeningBook> opening_book;
     std::vector<std::shared_ptr<Player>> players;
 
     void add_players();
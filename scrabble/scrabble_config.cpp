@@ -65,6 +65,20 @@ ScrabbleConfig ScrabbleConfig::read(string file_path) {
                     config.tile_bag_file_path = value_buffer;
                 } else if (key_buffer == "DICTIONARY") {
                     config.dictionary_file_path = value_buffer;
+                } else if (key_buffer == "TRACE") {
+                    config.trace_file_path = value_buffer;
+                } else if (key_buffer == "OPENING_BOOK") {
+                    config.opening_book_file_path = value_buffer;
+                } else if (key_buffer == "LEXICON") {
+                    config.lexicon_name = value_buffer;
+                } else if (key_buffer == "LEXICON_FILE") {
+                    // the lexicon's name, then its file
+                    size_t space = value_buffer.find_first_of(" \t");
+                    size_t path = value_buffer.find_first_not_of(" \t", space);
+                    if (path == string::npos) {
+                        throw FileException("LEXICON_FILE needs a name and a file!");
+                    }
+                    config.lexicon_file_paths[value_buffer.substr(0, space)] = value_buffer.substr(path);
                 }
                 state = ParserState::LOOKING_FOR_KEY;
             } else {
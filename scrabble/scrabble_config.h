@@ -3,6 +3,7 @@
 
 #include <string>
 #include <cstdint>
+#include <map>
 
 
 class ScrabbleConfig {
@@ -13,6 +14,10 @@ public:
     std::string board_file_path;
     std::string tile_bag_file_path;
     std::string dictionary_file_path;
+    std::string trace_file_path; // optional; no trace is written if empty
+    std::string opening_book_file_path; // optional; openings are searched if empty
+    std::string lexicon_name; // optional; the dictionary file is used if empty
+    std::map<std::string, std::string> lexicon_file_paths; // the lexicons lexicon_name can pick, by name
 
     static ScrabbleConfig read(std::string file_path);
 };
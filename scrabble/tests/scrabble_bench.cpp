@@ -0,0 +1,311 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "computer_player.h"
+#include "dictionary.h"
+#include "move.h"
+#include "position_cache.h"
+#include "tile_bag.h"
+
+using namespace std;
+
+#define DICT_PATH "config/english-dictionary.txt"
+#define BOARD_PATH "config/standard-board.txt"
+#define BAG_PATH "config/english-tile-bag.txt"
+
+// Every allocation made by the process, so that each benchmark can report
+// allocations per operation.
+static atomic<size_t> allocations(0);
+
+void *operator new(size_t size) {
+	allocations.fetch_add(1, memory_order_relaxed);
+	void *p = malloc(size == 0 ? 1 : size);
+	if (p == nullptr)
+		throw bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// Counts allocations from construction until report().
+class AllocationCounter {
+public:
+	AllocationCounter() : start(allocations.load()) {}
+	void report(benchmark::State &state) {
+		state.counters["allocs/op"] = benchmark::Counter(
+			double(allocations.load() - start), benchmark::Counter::kAvgIterations);
+	}
+private:
+	size_t start;
+};
+
+static const Dictionary &dictionary() {
+	static Dictionary d = Dictionary::read(DICT_PATH);
+	return d;
+}
+
+// Every 50th word of the dictionary file.
+static const vector<string> &word_sample() {
+	static vector<string> words;
+	if (words.empty()) {
+		ifstream file(DICT_PATH);
+		string word;
+		for (size_t i = 0; file >> word; ++i) {
+			if (i % 50 == 0)
+				words.push_back(word);
+		}
+	}
+	return words;
+}
+
+// Every word of the dictionary file, in file order or shuffled. The file is
+// sorted, so in file order each word mostly follows the path of the one
+// before it through the trie, already in cache; shuffled, few do.
+static const vector<string> &word_list(bool shuffled = false) {
+	static vector<string> words[2];
+	if (words[shuffled].empty()) {
+		ifstream file(DICT_PATH);
+		string word;
+		while (file >> word)
+			words[shuffled].push_back(word);
+		if (shuffled) {
+			mt19937 random(42);
+			shuffle(words[shuffled].begin(), words[shuffled].end(), random);
+		}
+	}
+	return words[shuffled];
+}
+
+static void place_word(Board &b, const string &letters, size_t row, size_t column, Direction d) {
+	vector<TileKind> t;
+	for (char letter : letters)
+		t.push_back(TileKind(letter, 1));
+	b.place(Move(t, row, column, d));
+}
+
+// The positions used by the ComputerPlayer tests.
+enum Position { EMPTY, SIMPLE, CONCAVE, STRESS };
+
+static Board position_board(int position) {
+	Board b = Board::read(BOARD_PATH);
+	if (position == SIMPLE) {
+		place_word(b, "HI", 7, 7, Direction::ACROSS);
+	} else if (position == CONCAVE || position == STRESS) {
+		place_word(b, "AUNTY", 7, 7, Direction::ACROSS);
+		place_word(b, "BER", 5, 7, Direction::DOWN);
+		place_word(b, "ANLER", 5, 10, Direction::DOWN);
+		place_word(b, "I", 6, 9, Direction::DOWN);
+	}
+	return b;
+}
+
+static vector<TileKind> position_rack(int position) {
+	if (position == STRESS) {
+		return {TileKind('A', 3), TileKind('?', 1), TileKind('T', 1), TileKind('M', 3), TileKind('?', 1),
+			TileKind('S', 4), TileKind('Z', 7), TileKind('P', 2), TileKind('D', 3), TileKind('F', 4)};
+	}
+	return {TileKind('A', 3), TileKind('B', 1), TileKind('F', 2), TileKind('T', 1),
+		TileKind('N', 3), TileKind('O', 7), TileKind('S', 4)};
+}
+
+static const char *position_name(int position) {
+	static const char *names[] = {"empty", "simple", "concave", "stress"};
+	return names[position];
+}
+
+
+static void BM_dictionary_read(benchmark::State &state) {
+	AllocationCounter counter;
+	for (auto _ : state) {
+		Dictionary d = Dictionary::read(DICT_PATH);
+		benchmark::DoNotOptimize(d.get_root());
+	}
+	counter.report(state);
+}
+BENCHMARK(BM_dictionary_read)->Unit(benchmark::kMillisecond);
+
+// Dictionary::read_parallel on state.range(0) threads.
+static void BM_dictionary_read_parallel(benchmark::State &state) {
+	AllocationCounter counter;
+	for (auto _ : state) {
+		Dictionary d = Dictionary::read_parallel(DICT_PATH, state.range(0));
+		benchmark::DoNotOptimize(d.get_root());
+	}
+	counter.report(state);
+}
+BENCHMARK(BM_dictionary_read_parallel)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_find_prefix(benchmark::State &state) {
+	const Dictionary &d = dictionary();
+	const vector<string> &words = word_sample();
+	AllocationCounter counter;
+	for (auto _ : state) {
+		for (const string &word : words)
+			benchmark::DoNotOptimize(d.find_prefix(word.substr(0, (word.size() + 1) / 2)));
+	}
+	counter.report(state);
+	state.SetItemsProcessed(state.iterations() * words.size());
+}
+BENCHMARK(BM_find_prefix);
+
+static void BM_is_word(benchmark::State &state) {
+	const Dictionary &d = dictionary();
+	const vector<string> &words = word_sample();
+	AllocationCounter counter;
+	for (auto _ : state) {
+		for (const string &word : words)
+			benchmark::DoNotOptimize(d.is_word(word));
+	}
+	counter.report(state);
+	state.SetItemsProcessed(state.iterations() * words.size());
+}
+BENCHMARK(BM_is_word);
+
+// One query per range(0): a pattern, a rack's anagrams, and the first
+// hundred words of a pattern most of the lexicon matches.
+static void BM_query(benchmark::State &state) {
+	const Dictionary &d = dictionary();
+	Dictionary::Query query;
+	if (state.range(0) == 0) {
+		query = Dictionary::Query::pattern("c?t*");
+		state.SetLabel("c?t*");
+	} else if (state.range(0) == 1) {
+		query = Dictionary::Query::anagrams("retains?");
+		state.SetLabel("anagrams of retains?");
+	} else {
+		query = Dictionary::Query::pattern("*e*");
+		query.limit = 100;
+		state.SetLabel("*e* first 100");
+	}
+	AllocationCounter counter;
+	size_t found = 0;
+	string word;
+	for (auto _ : state) {
+		Dictionary::Matches matches = d.query(query);
+		while (matches.next(word))
+			++found;
+	}
+	counter.report(state);
+	state.SetItemsProcessed(found);
+}
+BENCHMARK(BM_query)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+// The whole word list, one is_word call after another, in file order (0) or
+// shuffled (1).
+static void BM_is_word_sequential(benchmark::State &state) {
+	const Dictionary &d = dictionary();
+	const vector<string> &words = word_list(state.range(0));
+	for (auto _ : state) {
+		for (const string &word : words)
+			benchmark::DoNotOptimize(d.is_word(word));
+	}
+	state.SetItemsProcessed(state.iterations() * words.size());
+	state.SetLabel(state.range(0) ? "shuffled" : "file order");
+}
+BENCHMARK(BM_is_word_sequential)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// The whole word list, checked by check_words in batches of state.range(0),
+// in file order or shuffled as above by state.range(1).
+static void BM_check_words(benchmark::State &state) {
+	const Dictionary &d = dictionary();
+	const vector<string> &words = word_list(state.range(1));
+	vector<string_view> views(words.begin(), words.end());
+	size_t batch = state.range(0);
+	unique_ptr<bool[]> results(new bool[batch]);
+	for (auto _ : state) {
+		for (size_t first = 0; first < views.size(); first += batch)
+			benchmark::DoNotOptimize(d.check_words(views.data() + first,
+				min(batch, views.size() - first), results.get()));
+	}
+	state.SetItemsProcessed(state.iterations() * words.size());
+	state.SetLabel(state.range(1) ? "shuffled" : "file order");
+}
+BENCHMARK(BM_check_words)
+	->Args({1, 0})->Args({8, 0})->Args({16, 0})->Args({1024, 0})
+	->Args({1, 1})->Args({8, 1})->Args({16, 1})->Args({1024, 1})
+	->Unit(benchmark::kMillisecond);
+
+static void BM_get_anchors(benchmark::State &state) {
+	Board b = position_board(state.range(0));
+	AllocationCounter counter;
+	for (auto _ : state)
+		benchmark::DoNotOptimize(b.get_anchors());
+	counter.report(state);
+	state.SetLabel(position_name(state.range(0)));
+}
+BENCHMARK(BM_get_anchors)->DenseRange(EMPTY, CONCAVE);
+
+static void BM_test_place(benchmark::State &state) {
+	Board b = position_board(CONCAVE);
+	// the best move for the concave test rack
+	ComputerPlayer cpu("cpu", 7);
+	cpu.set_move_cache(false);
+	cpu.add_tiles(position_rack(CONCAVE));
+	Move m = cpu.get_move(b, dictionary());
+	AllocationCounter counter;
+	for (auto _ : state)
+		benchmark::DoNotOptimize(b.test_place(m));
+	counter.report(state);
+}
+BENCHMARK(BM_test_place);
+
+static void BM_remove_random_tiles(benchmark::State &state) {
+	TileBag full = TileBag::read(BAG_PATH, 10);
+	TileBag bag = full;
+	AllocationCounter counter;
+	for (auto _ : state) {
+		if (bag.count_tiles() < 7) {
+			state.PauseTiming();
+			bag = full;
+			state.ResumeTiming();
+		}
+		benchmark::DoNotOptimize(bag.remove_random_tiles(7));
+	}
+	counter.report(state);
+}
+BENCHMARK(BM_remove_random_tiles);
+
+static void BM_get_move(benchmark::State &state) {
+	Board b = position_board(state.range(0));
+	vector<TileKind> rack = position_rack(state.range(0));
+	ComputerPlayer cpu("cpu", rack.size());
+	// every iteration must search the whole board again
+	cpu.set_move_cache(false);
+	cpu.add_tiles(rack);
+	AllocationCounter counter;
+	for (auto _ : state)
+		benchmark::DoNotOptimize(cpu.get_move(b, dictionary()));
+	counter.report(state);
+	state.counters["moves/s"] = benchmark::Counter(double(state.iterations()), benchmark::Counter::kIsRate);
+	state.SetLabel(position_name(state.range(0)));
+}
+BENCHMARK(BM_get_move)->DenseRange(EMPTY, STRESS)->Unit(benchmark::kMillisecond);
+
+// The same position asked for again, answered by the position cache.
+static void BM_get_move_repeated(benchmark::State &state) {
+	Board b = position_board(state.range(0));
+	vector<TileKind> rack = position_rack(state.range(0));
+	ComputerPlayer cpu("cpu", rack.size());
+	cpu.set_position_cache(make_shared<PositionCache>(16));
+	cpu.add_tiles(rack);
+	cpu.get_move(b, dictionary());
+	AllocationCounter counter;
+	for (auto _ : state)
+		benchmark::DoNotOptimize(cpu.get_move(b, dictionary()));
+	counter.report(state);
+	state.SetLabel(position_name(state.range(0)));
+}
+BENCHMARK(BM_get_move_repeated)->DenseRange(EMPTY, STRESS)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -2,13 +2,25 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <thread>
 
 #include "scrabble_config.h"
 #include "board.h"
 #include "dictionary.h"
 #include "tile_kind.h"
 #include "human_player.h"
+#include "lexicon_registry.h"
 #include "computer_player.h"
+#include "opening_book.h"
+#include "packed_move.h"
+#include "position_cache.h"
+#include "trace.h"
+#include "turn_arena.h"
 
 #define DICT_PATH "config/english-dictionary.txt"
 
@@ -103,6 +115,316 @@ TEST_F(DictionaryTest, find_prefix_null) {
 	EXPECT_TRUE(pre == nullptr);
 }
 
+TEST_F(DictionaryTest, check_words) {
+	// more words than one batch walks at once, of mixed lengths
+	vector<string> words = {"hi", "abstractionists", "asdgadfg", "zoo", "", "z",
+		"absent", "absentee", "absenteeism", "qwxz", "hello", "hell", "helloo",
+		"a", "world", "worlds", "xylophone", "cat"};
+	vector<string_view> views(words.begin(), words.end());
+	bool results[18];
+	ASSERT_EQ(words.size(), 18u);
+	bool all_found = d.check_words(views.data(), views.size(), results);
+	EXPECT_FALSE(all_found);
+	for (size_t i = 0; i < words.size(); ++i)
+		EXPECT_EQ(results[i], d.is_word(words[i])) << words[i];
+
+	EXPECT_FALSE(d.all_words(words));
+	vector<string> found;
+	for (size_t i = 0; i < words.size(); ++i)
+		if (results[i])
+			found.push_back(words[i]);
+	EXPECT_GT(found.size(), 8u);
+	EXPECT_TRUE(d.all_words(found));
+	EXPECT_TRUE(d.all_words(vector<string>()));
+}
+
+TEST_F(DictionaryTest, find_prefixes) {
+	// more prefixes than one batch walks at once, some of them no word has
+	vector<string> prefixes = {"", "h", "hel", "hello", "helloz", "abs",
+		"absentee", "qwx", "z", "zoo", "xylo", "xyloq", "wor", "world",
+		"worlds", "c", "ca", "cat", "catz", "a", "Cat", "ca't", "don't",
+		"county's"};
+	ASSERT_GT(prefixes.size(), Dictionary::MAX_BATCH_WALKS);
+	vector<string_view> views(prefixes.begin(), prefixes.end());
+	vector<const Dictionary::TrieNode *> nodes(prefixes.size());
+	d.find_prefixes(views.data(), views.size(), nodes.data());
+	for (size_t i = 0; i < prefixes.size(); ++i)
+		EXPECT_EQ(nodes[i], d.find_prefix(prefixes[i]).get()) << prefixes[i];
+	EXPECT_EQ(nodes[0], d.get_root().get());
+}
+
+TEST_F(DictionaryTest, find_prefixes_other_letters) {
+	// a letter other than a-z or an apostrophe has find_prefixes walk the
+	// trie itself
+	{
+		ofstream words("dictionary_test_words.txt");
+		words << "cat\ndo\ndon't\nrock'n'roll\nx-ray\n";
+	}
+	Dictionary other = Dictionary::read("dictionary_test_words.txt");
+	remove("dictionary_test_words.txt");
+
+	vector<string> words = {"don't", "don", "do", "rock'n'roll", "rock'",
+		"x-ray", "x-", "cats"};
+	vector<string_view> views(words.begin(), words.end());
+	vector<const Dictionary::TrieNode *> nodes(words.size());
+	other.find_prefixes(views.data(), views.size(), nodes.data());
+	bool results[8];
+	ASSERT_EQ(words.size(), 8u);
+	EXPECT_FALSE(other.check_words(views.data(), views.size(), results));
+	for (size_t i = 0; i < words.size(); ++i) {
+		EXPECT_EQ(nodes[i], other.find_prefix(words[i]).get()) << words[i];
+		EXPECT_EQ(results[i], other.is_word(words[i])) << words[i];
+	}
+	EXPECT_TRUE(results[0]);
+	EXPECT_TRUE(results[3]);
+	EXPECT_TRUE(results[5]);
+}
+
+TEST_F(DictionaryTest, subtree_annotations) {
+	EXPECT_EQ(d.get_root()->words, d.get_word_count());
+	EXPECT_GT(d.get_word_count(), 1000u);
+
+	// "abstractionism", "abstractionist" and "abstractionists" are below
+	shared_ptr<Dictionary::TrieNode> node = d.find_prefix("abstractionis");
+	ASSERT_NE(node, nullptr);
+	EXPECT_EQ(node->words, 3u);
+	EXPECT_EQ(node->min_length, 1u);
+	EXPECT_EQ(node->max_length, 2u);
+
+	node = d.find_prefix("hello");
+	ASSERT_NE(node, nullptr);
+	EXPECT_TRUE(node->is_final);
+	EXPECT_EQ(node->min_length, 0u);
+	EXPECT_GE(node->max_length, 1u);
+
+	// word_at counts every word once, in alphabetical order
+	string last;
+	for (size_t i = 0; i < d.get_word_count(); i += 997) {
+		string word = d.word_at(i);
+		EXPECT_TRUE(d.is_word(word)) << i;
+		EXPECT_LT(last, word);
+		last = word;
+	}
+	EXPECT_EQ(d.word_at(d.get_word_count()), "");
+}
+
+TEST_F(DictionaryTest, reversed_trie) {
+	shared_ptr<Dictionary::TrieNode> node = d.find_suffix("ing");
+	ASSERT_NE(node, nullptr);
+	EXPECT_NE(node->nexts.find('k'), node->nexts.end());
+	EXPECT_EQ(d.find_suffix("qxz"), nullptr);
+	EXPECT_EQ(d.find_suffix(""), d.get_reversed_root());
+	EXPECT_TRUE(d.find_suffix("hello")->is_final);
+	EXPECT_EQ(d.get_reversed_root()->words, d.get_word_count());
+
+	// hooks in front, behind and on both sides, as is_word finds them
+	vector<pair<string, string>> sides = {{"", "at"}, {"ca", ""}, {"c", "t"},
+		{"", "ello"}, {"hel", "o"}, {"", "qxz"}, {"zzz", ""}};
+	for (const auto &side : sides) {
+		uint32_t letters = d.cross_letters(side.first, side.second);
+		for (char letter = 'a'; letter <= 'z'; ++letter)
+			EXPECT_EQ(letters >> (letter - 'a') & 1,
+				d.is_word(side.first + letter + side.second))
+				<< side.first << letter << side.second;
+	}
+	EXPECT_NE(d.cross_letters("", "at"), 0u);
+	EXPECT_EQ(d.cross_letters("", "qxz"), 0u);
+}
+
+// whether word matches a pattern of letters, ? and *
+static bool matches_pattern(const string &word, const string &pattern) {
+	if (pattern.empty())
+		return word.empty();
+	if (pattern[0] == '*')
+		return matches_pattern(word, pattern.substr(1)) ||
+			(!word.empty() && matches_pattern(word.substr(1), pattern));
+	return !word.empty() && (pattern[0] == '?' || pattern[0] == word[0]) &&
+		matches_pattern(word.substr(1), pattern.substr(1));
+}
+
+TEST_F(DictionaryTest, query_pattern) {
+	for (string pattern : {"c?t*", "*ing", "h*l*o", "?a?", "q*"}) {
+		vector<string> expected;
+		for (size_t i = 0; i < d.get_word_count(); ++i) {
+			string word = d.word_at(i);
+			if (matches_pattern(word, pattern))
+				expected.push_back(word);
+		}
+		Dictionary::Matches matches = d.query(Dictionary::Query::pattern(pattern));
+		vector<string> found;
+		string word;
+		while (matches.next(word))
+			found.push_back(word);
+		EXPECT_EQ(found, expected) << pattern;
+		EXPECT_EQ(matches.get_count(), expected.size());
+	}
+
+	Dictionary::Query query = Dictionary::Query::pattern("[bc][aeiou]t");
+	Dictionary::Matches matches = d.query(query);
+	string word;
+	size_t found = 0;
+	while (matches.next(word)) {
+		EXPECT_EQ(word.size(), 3u);
+		EXPECT_NE(string("bc").find(word[0]), string::npos) << word;
+		EXPECT_NE(string("aeiou").find(word[1]), string::npos) << word;
+		++found;
+	}
+	EXPECT_GE(found, 4u);
+
+	// the cap stops the walk, however many words are left
+	query = Dictionary::Query::pattern("*");
+	query.limit = 5;
+	matches = d.query(query);
+	for (found = 0; matches.next(word); ++found)
+		EXPECT_EQ(word, d.word_at(found));
+	EXPECT_EQ(found, 5u);
+
+	EXPECT_THROW(Dictionary::Query::pattern("c[at"), CommandException);
+	EXPECT_THROW(Dictionary::Query::pattern("c-t"), CommandException);
+}
+
+TEST_F(DictionaryTest, query_rack) {
+	vector<string> expected = d.find_anagrams("aenrst", 1);
+	sort(expected.begin(), expected.end());
+	expected.erase(unique(expected.begin(), expected.end()), expected.end());
+	Dictionary::Matches matches = d.query(Dictionary::Query::anagrams("tsr?nea"));
+	vector<string> found;
+	string word;
+	while (matches.next(word))
+		found.push_back(word);
+	EXPECT_EQ(found, expected);
+
+	// some of the tiles, no more of a letter than the rack holds
+	Dictionary::Query query = Dictionary::Query::pattern("*");
+	query.set_rack("cat");
+	matches = d.query(query);
+	found.clear();
+	while (matches.next(word)) {
+		string letters = word;
+		sort(letters.begin(), letters.end());
+		EXPECT_TRUE(letters == "a" || letters == "c" || letters == "t" ||
+			letters == "ac" || letters == "at" || letters == "ct" ||
+			letters == "act") << word;
+		found.push_back(word);
+	}
+	EXPECT_NE(find(found.begin(), found.end(), "cat"), found.end());
+	EXPECT_NE(find(found.begin(), found.end(), "act"), found.end());
+	EXPECT_EQ(find(found.begin(), found.end(), "tact"), found.end());
+	EXPECT_THROW(query.set_rack("ca!"), CommandException);
+}
+
+// every node of lhs and rhs, compared in the same order
+static void expect_same_trie(const Dictionary::TrieNode *lhs,
+		const Dictionary::TrieNode *rhs, vector<bool> &ids) {
+	ASSERT_EQ(lhs->is_final, rhs->is_final);
+	ASSERT_EQ(lhs->words, rhs->words);
+	ASSERT_EQ(lhs->min_length, rhs->min_length);
+	ASSERT_EQ(lhs->max_length, rhs->max_length);
+	ASSERT_LT(rhs->id, ids.size());
+	ASSERT_FALSE(ids[rhs->id]);
+	ids[rhs->id] = true;
+	ASSERT_EQ(lhs->nexts.size(), rhs->nexts.size());
+	auto left = lhs->nexts.begin();
+	auto right = rhs->nexts.begin();
+	for (; left != lhs->nexts.end(); ++left, ++right) {
+		ASSERT_EQ(left->first, right->first);
+		expect_same_trie(left->second.get(), right->second.get(), ids);
+	}
+}
+
+TEST_F(DictionaryTest, read_parallel) {
+	for (size_t threads : {1, 3}) {
+		Dictionary parallel = Dictionary::read_parallel(DICT_PATH, threads);
+		EXPECT_EQ(parallel.get_hash(), d.get_hash());
+		EXPECT_EQ(parallel.get_word_count(), d.get_word_count());
+		ASSERT_EQ(parallel.get_node_count(), d.get_node_count());
+
+		// the same tries, every node numbered once
+		vector<bool> ids(parallel.get_node_count(), false);
+		expect_same_trie(d.get_root().get(), parallel.get_root().get(), ids);
+		expect_same_trie(d.get_reversed_root().get(),
+			parallel.get_reversed_root().get(), ids);
+		EXPECT_EQ(count(ids.begin(), ids.end(), false), 0);
+
+		EXPECT_EQ(parallel.find_anagrams("aeinrst", 0),
+			d.find_anagrams("aeinrst", 0));
+	}
+	EXPECT_THROW(Dictionary::read_parallel("no-such-file.txt", 2),
+		FileException);
+}
+
+TEST_F(DictionaryTest, lexicon_registry) {
+	LexiconRegistry lexicons;
+	lexicons.add("english", DICT_PATH);
+	lexicons.add("english", DICT_PATH);
+	lexicons.add("missing", "no-such-file.txt");
+	EXPECT_THROW(lexicons.add("english", "other.txt"), FileException);
+	EXPECT_THROW(lexicons.get("klingon"), FileException);
+
+	vector<LexiconRegistry::Usage> usage = lexicons.get_usage();
+	ASSERT_EQ(usage.size(), 2u);
+	EXPECT_FALSE(usage[0].loaded);
+
+	// read once, whichever thread asks first
+	vector<shared_ptr<const Dictionary>> found(4);
+	vector<thread> threads;
+	for (size_t i = 0; i < found.size(); ++i)
+		threads.emplace_back([&, i]() { found[i] = lexicons.get("english"); });
+	for (thread &t : threads)
+		t.join();
+	for (const shared_ptr<const Dictionary> &dictionary : found)
+		EXPECT_EQ(dictionary, found[0]);
+	EXPECT_EQ(found[0]->get_hash(), d.get_hash());
+	EXPECT_TRUE(found[0]->is_word("hello"));
+
+	usage = lexicons.get_usage();
+	EXPECT_EQ(usage[0].name, "english");
+	EXPECT_TRUE(usage[0].loaded);
+	EXPECT_EQ(usage[0].words, d.get_word_count());
+	EXPECT_EQ(usage[0].nodes, d.get_node_count());
+	EXPECT_GT(usage[0].bytes, usage[0].nodes * sizeof(Dictionary::TrieNode));
+	EXPECT_EQ(usage[1].name, "missing");
+	EXPECT_THROW(lexicons.get("missing"), FileException);
+	EXPECT_FALSE(lexicons.get_usage()[1].loaded);
+
+	{
+		ofstream config("lexicon_test_config.txt");
+		config << "dictionary: " DICT_PATH "\n"
+			<< "lexicon_file: english " DICT_PATH "\n"
+			<< "lexicon_file: club  club-words.txt\n"
+			<< "lexicon: club\n";
+	}
+	ScrabbleConfig config = ScrabbleConfig::read("lexicon_test_config.txt");
+	remove("lexicon_test_config.txt");
+	EXPECT_EQ(config.lexicon_name, "club");
+	ASSERT_EQ(config.lexicon_file_paths.size(), 2u);
+	EXPECT_EQ(config.lexicon_file_paths["english"], DICT_PATH);
+	EXPECT_EQ(config.lexicon_file_paths["club"], "club-words.txt");
+}
+
+TEST_F(DictionaryTest, find_anagrams) {
+	vector<string> words = d.find_anagrams("tsrenia", 0);
+	EXPECT_NE(find(words.begin(), words.end(), "retains"), words.end());
+	EXPECT_NE(find(words.begin(), words.end(), "nastier"), words.end());
+	for (const string &word : words) {
+		string letters = word;
+		sort(letters.begin(), letters.end());
+		EXPECT_EQ(letters, "aeinrst");
+		EXPECT_TRUE(d.is_word(word));
+	}
+
+	// blanks stand for any letter
+	vector<string> blank = d.find_anagrams("aeinrs", 1);
+	EXPECT_NE(find(blank.begin(), blank.end(), "arsenic"), blank.end());
+	EXPECT_NE(find(blank.begin(), blank.end(), "retains"), blank.end());
+	vector<string> eights = d.find_anagrams("aeinrst", 1);
+	EXPECT_NE(find(eights.begin(), eights.end(), "strainer"), eights.end());
+	EXPECT_EQ(find(eights.begin(), eights.end(), "retains"), eights.end());
+
+	// only bingo lengths are indexed
+	EXPECT_TRUE(d.find_anagrams("tac", 0).empty());
+}
+
 
 // Helper functions for placing words in get_anchors() and get_move() tests
 void place_simple_word(Board &b) {
@@ -533,6 +855,46 @@ TEST_F(AnchorTest, concave) {
 	EXPECT_TRUE(anchor_lookup(a, Board::Anchor(Board::Position(5,6), Direction::DOWN, 5)));
 }
 
+TEST_F(AnchorTest, trial_move) {
+	Board b = Board::read("config/standard-board.txt");
+	place_two_words(b);
+	vector<Board::Anchor> before = b.get_anchors();
+
+	vector<TileKind> t;
+    t.push_back(TileKind('T', 1));
+    t.push_back(TileKind('E', 1));
+	{
+		Board::TrialMove trial(b, Move(t, 7, 9, Direction::ACROSS));
+		EXPECT_TRUE(trial.result().valid);
+		EXPECT_EQ(trial.placed().size(), 2u);
+		EXPECT_TRUE(b.in_bounds_and_has_tile(Board::Position(7, 9)));
+	}
+
+	vector<Board::Anchor> after = b.get_anchors();
+	ASSERT_EQ(before.size(), after.size());
+	for (size_t i = 0; i < after.size(); ++i)
+		EXPECT_TRUE(anchor_lookup(before, after[i]));
+	EXPECT_FALSE(b.in_bounds_and_has_tile(Board::Position(7, 9)));
+	EXPECT_TRUE(b.in_bounds_and_has_tile(Board::Position(7, 8)));
+
+	// an explicit undo is not repeated when the trial ends
+	{
+		Board::TrialMove trial(b, Move(t, 7, 9, Direction::ACROSS));
+		trial.undo();
+		EXPECT_FALSE(b.in_bounds_and_has_tile(Board::Position(7, 9)));
+		trial.undo();
+	}
+	EXPECT_TRUE(b.in_bounds_and_has_tile(Board::Position(7, 8)));
+
+	// a move that cannot be placed leaves the board alone
+	{
+		Board::TrialMove trial(b, Move(t, 0, 0, Direction::ACROSS));
+		EXPECT_FALSE(trial.result().valid);
+		EXPECT_TRUE(trial.placed().empty());
+	}
+	EXPECT_EQ(b.get_anchors().size(), after.size());
+}
+
 
 class ComputerPlayerTest : public testing::Test {
 protected:
@@ -1010,3 +1372,881 @@ TEST_F(ComputerPlayerTest, stress_test) {
 	test_pts(res, 57);
 }
 
+
+TEST_F(ComputerPlayerTest, stress_test_time_budget) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cpu("cpu", 10);
+
+	place_concave_words(b);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+	t0.push_back(TileKind('?', 1));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('M', 3));
+	t0.push_back(TileKind('?', 1));
+	t0.push_back(TileKind('S', 4));
+	t0.push_back(TileKind('Z', 7));
+	t0.push_back(TileKind('P', 2));
+	t0.push_back(TileKind('D', 3));
+	t0.push_back(TileKind('F', 4));
+
+	cpu.add_tiles(t0);
+
+	// without a budget the whole search runs
+	Move full = cpu.get_move(b, d);
+	EXPECT_FALSE(cpu.get_search_stats().timed_out);
+	ASSERT_EQ(full.kind, MoveKind::PLACE);
+
+	// the full search takes far longer than a millisecond, so it is cut short,
+	// but not before it has a move to play
+	cpu.set_time_budget(std::chrono::milliseconds(1));
+	cpu.set_move_cache(false);
+	Move m = cpu.get_move(b, d);
+	EXPECT_TRUE(cpu.get_search_stats().timed_out);
+	ASSERT_EQ(m.kind, MoveKind::PLACE);
+	PlaceResult res = b.test_place(m);
+	EXPECT_TRUE(res.valid);
+	for (size_t i = 0; i < res.words.size(); ++i)
+		EXPECT_TRUE(d.is_word(res.words[i]));
+}
+
+TEST_F(ComputerPlayerTest, time_budget_keeps_bingo) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cpu("cpu", 7);
+
+	vector<TileKind> t1;
+	t1.push_back(TileKind('H', 4));
+	t1.push_back(TileKind('I', 1));
+	b.place(Move(t1, 7, 7, Direction::ACROSS));
+
+	vector<TileKind> t0;
+	t0.push_back(TileKind('R', 1));
+	t0.push_back(TileKind('E', 1));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('A', 1));
+	t0.push_back(TileKind('I', 1));
+	t0.push_back(TileKind('N', 1));
+	t0.push_back(TileKind('?', 0));
+	cpu.add_tiles(t0);
+	cpu.set_time_budget(std::chrono::milliseconds(1));
+	cpu.set_move_cache(false);
+
+	// the bingos found before the search are there to play when time runs out
+	auto begin = std::chrono::steady_clock::now();
+	Move m = cpu.get_move(b, d);
+	auto elapsed = std::chrono::steady_clock::now() - begin;
+
+	ASSERT_EQ(m.kind, MoveKind::PLACE);
+	EXPECT_EQ(m.tiles.size(), 7u);
+	PlaceResult res = b.test_place(m);
+	EXPECT_TRUE(res.valid);
+	for (size_t i = 0; i < res.words.size(); ++i)
+		EXPECT_TRUE(d.is_word(res.words[i]));
+	EXPECT_GT(cpu.get_search_stats().bingos_found, 0u);
+	EXPECT_TRUE(cpu.get_search_stats().timed_out);
+	// far more than the search needs to score one bingo, even unoptimized
+	EXPECT_LT(elapsed, std::chrono::milliseconds(500));
+}
+
+bool same_move(const Move &lhs, const Move &rhs) {
+	if (lhs.kind != rhs.kind || lhs.tiles.size() != rhs.tiles.size())
+		return false;
+	if (lhs.kind == MoveKind::PLACE && (lhs.row != rhs.row ||
+		lhs.column != rhs.column || lhs.direction != rhs.direction))
+		return false;
+	for (size_t i = 0; i < lhs.tiles.size(); ++i) {
+		if (lhs.tiles[i].letter != rhs.tiles[i].letter ||
+			lhs.tiles[i].assigned != rhs.tiles[i].assigned)
+			return false;
+	}
+	return true;
+}
+
+TEST_F(ComputerPlayerTest, pruning_matches_full_search) {
+	Dictionary d = Dictionary::read(DICT_PATH);
+	void (*setups[])(Board &) = {place_simple_word, place_two_words,
+		place_long_word, place_concave_words};
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+	t0.push_back(TileKind('?', 1));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('M', 3));
+	t0.push_back(TileKind('S', 4));
+	t0.push_back(TileKind('Z', 7));
+	t0.push_back(TileKind('E', 1));
+
+	size_t nodes_pruned = 0;
+	for (auto setup : setups) {
+		Board b = Board::read("config/standard-board.txt");
+		setup(b);
+
+		ComputerPlayer pruned("cpu", 7);
+		ComputerPlayer full("cpu", 7);
+		full.set_pruning(false);
+		pruned.add_tiles(t0);
+		full.add_tiles(t0);
+
+		Move expected = full.get_move(b, d);
+		Move m = pruned.get_move(b, d);
+		EXPECT_TRUE(same_move(m, expected));
+		EXPECT_EQ(full.get_search_stats().nodes_pruned, 0u);
+		nodes_pruned += pruned.get_search_stats().nodes_pruned;
+	}
+	EXPECT_GT(nodes_pruned, 0u);
+}
+
+TEST_F(ComputerPlayerTest, top_moves_ranked) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cpu("cpu", 7);
+
+	place_concave_words(b);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+    t0.push_back(TileKind('B', 1));
+	t0.push_back(TileKind('F', 2));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('N', 3));
+	t0.push_back(TileKind('O', 7));
+	t0.push_back(TileKind('S', 4));
+
+	cpu.add_tiles(t0);
+
+	vector<RankedMove> top = cpu.get_top_moves(b, d, 20);
+	ASSERT_EQ(top.size(), 20u);
+	EXPECT_EQ(top[0].points, 51u);
+	EXPECT_TRUE(same_move(top[0].move, cpu.get_move(b, d)));
+
+	for (size_t i = 0; i < top.size(); ++i) {
+		if (i > 0) {
+			EXPECT_GE(top[i - 1].points, top[i].points);
+		}
+		PlaceResult res = b.test_place(top[i].move);
+		EXPECT_TRUE(res.valid);
+		EXPECT_EQ(res.words, top[i].words);
+		EXPECT_EQ(top[i].leave.size() + top[i].move.tiles.size(), 7u);
+		for (size_t j = 0; j < res.words.size(); ++j)
+			EXPECT_TRUE(d.is_word(res.words[j]));
+	}
+
+	vector<RankedMove> top3 = cpu.get_top_moves(b, d, 3);
+	ASSERT_EQ(top3.size(), 3u);
+	for (size_t i = 0; i < top3.size(); ++i)
+		EXPECT_EQ(top3[i].points, top[i].points);
+}
+
+class HumanPlayerTest : public testing::Test {
+protected:
+	// Feeds input to get_move() through cin and collects what it prints.
+	Move run_move(const HumanPlayer &human, const Board &b, const Dictionary &d,
+	              const string &input, string &output) {
+		istringstream in(input);
+		ostringstream out;
+		streambuf *old_in = cin.rdbuf(in.rdbuf());
+		streambuf *old_out = cout.rdbuf(out.rdbuf());
+		Move move = human.get_move(b, d);
+		cin.rdbuf(old_in);
+		cout.rdbuf(old_out);
+		output = out.str();
+		return move;
+	}
+};
+
+TEST_F(HumanPlayerTest, hint_prints_ranked_place_commands) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	HumanPlayer human("human", 7);
+	ComputerPlayer cpu("cpu", 7);
+
+	place_concave_words(b);
+
+	vector<TileKind> t0;
+	t0.push_back(TileKind('a', 1));
+	t0.push_back(TileKind('b', 3));
+	t0.push_back(TileKind('f', 4));
+	t0.push_back(TileKind('t', 1));
+	t0.push_back(TileKind('n', 1));
+	t0.push_back(TileKind('o', 1));
+	t0.push_back(TileKind('s', 1));
+	human.add_tiles(t0);
+	cpu.add_tiles(t0);
+
+	string output;
+	Move move = run_move(human, b, d, "HINT\nPASS\n", output);
+	EXPECT_EQ(move.kind, MoveKind::PASS);
+
+	vector<RankedMove> top = cpu.get_top_moves(b, d, HumanPlayer::HINT_COUNT);
+	ASSERT_EQ(top.size(), 3u);
+	for (size_t i = 0; i < top.size(); ++i) {
+		const Move &m = top[i].move;
+		ostringstream expected;
+		expected << i + 1 << ". PLACE "
+		         << (m.direction == Direction::ACROSS ? "-" : "|") << " "
+		         << m.row + 1 << " " << m.column + 1 << " ";
+		for (size_t j = 0; j < m.tiles.size(); ++j) {
+			expected << m.tiles[j].letter;
+		}
+		expected << " (";
+		EXPECT_NE(output.find(expected.str()), string::npos) << expected.str();
+	}
+	EXPECT_EQ(output.find("4. PLACE"), string::npos);
+}
+
+TEST_F(HumanPlayerTest, place_rejects_bad_cross_word) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	HumanPlayer human("human", 7);
+
+	vector<TileKind> t1;
+	t1.push_back(TileKind('a', 1));
+	t1.push_back(TileKind('u', 1));
+	t1.push_back(TileKind('n', 1));
+	t1.push_back(TileKind('t', 1));
+	t1.push_back(TileKind('y', 4));
+	b.place(Move(t1, 7, 7, Direction::ACROSS));
+
+	vector<TileKind> t0;
+	t0.push_back(TileKind('o', 1));
+	t0.push_back(TileKind('x', 8));
+	human.add_tiles(t0);
+
+	// "ox" is a word, but it sits under "au" and forms "ao" and "ux".
+	ASSERT_TRUE(d.is_word("ox"));
+	ASSERT_TRUE(b.test_place(Move(t0, 8, 7, Direction::ACROSS)).valid);
+
+	string output;
+	Move move = run_move(human, b, d, "PLACE - 9 8 ox\nPASS\n", output);
+	EXPECT_EQ(move.kind, MoveKind::PASS);
+	EXPECT_NE(output.find("Word not in dictionary"), string::npos);
+}
+
+TEST_F(ComputerPlayerTest, lookahead_best_differential) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cpu("cpu", 7);
+
+	place_concave_words(b);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+    t0.push_back(TileKind('B', 1));
+	t0.push_back(TileKind('F', 2));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('N', 3));
+	t0.push_back(TileKind('O', 7));
+	t0.push_back(TileKind('S', 4));
+	cpu.add_tiles(t0);
+
+	vector<TileKind> t1;
+    t1.push_back(TileKind('E', 1));
+    t1.push_back(TileKind('Q', 10));
+	t1.push_back(TileKind('U', 1));
+	t1.push_back(TileKind('I', 1));
+	t1.push_back(TileKind('R', 1));
+	t1.push_back(TileKind('Z', 10));
+	t1.push_back(TileKind('?', 0));
+
+	// replies found on a fresh copy of the board for every candidate
+	const size_t candidates = 8;
+	vector<RankedMove> top = cpu.get_top_moves(b, d, candidates);
+	ASSERT_EQ(top.size(), candidates);
+	long best = 0;
+	for (size_t i = 0; i < top.size(); ++i) {
+		Board copy = b;
+		copy.place(top[i].move);
+		ComputerPlayer opponent("opponent", 7);
+		opponent.add_tiles(t1);
+		vector<RankedMove> reply = opponent.get_top_moves(copy, d, 1);
+		long spread = long(top[i].points) - (reply.empty() ? 0 : long(reply[0].points));
+		if (i == 0 || spread > best)
+			best = spread;
+	}
+
+	cpu.set_lookahead(candidates);
+	cpu.set_opponent_rack(t1);
+	Move m = cpu.get_move(b, d);
+
+	Board copy = b;
+	PlaceResult res = copy.place(m);
+	ASSERT_TRUE(res.valid);
+	unsigned int points = res.points + (m.tiles.size() == 7 ? 50 : 0);
+	ComputerPlayer opponent("opponent", 7);
+	opponent.add_tiles(t1);
+	vector<RankedMove> reply = opponent.get_top_moves(copy, d, 1);
+	EXPECT_EQ(long(points) - (reply.empty() ? 0 : long(reply[0].points)), best);
+
+	// the board searched is left as it was
+	EXPECT_TRUE(same_move(cpu.get_top_moves(b, d, 1)[0].move, top[0].move));
+}
+
+TEST_F(ComputerPlayerTest, move_cache_matches_full_search) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cached("cached", 7);
+	ComputerPlayer uncached("uncached", 7);
+	uncached.set_move_cache(false);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+    t0.push_back(TileKind('B', 1));
+	t0.push_back(TileKind('F', 2));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('N', 3));
+	t0.push_back(TileKind('O', 7));
+	t0.push_back(TileKind('?', 0));
+	cached.add_tiles(t0);
+	uncached.add_tiles(t0);
+
+	// each placement changes a few lines; the rest come from the cache
+	for (int turn = 0; turn < 4; ++turn) {
+		if (turn == 1)
+			place_concave_words(b);
+		if (turn > 1)
+			b.place(uncached.get_move(b, d));
+
+		vector<RankedMove> expected = uncached.get_top_moves(b, d, 5);
+		vector<RankedMove> top = cached.get_top_moves(b, d, 5);
+		ASSERT_EQ(top.size(), expected.size());
+		for (size_t i = 0; i < top.size(); ++i) {
+			EXPECT_EQ(top[i].points, expected[i].points);
+			EXPECT_TRUE(same_move(top[i].move, expected[i].move));
+		}
+	}
+
+	cached.get_top_moves(b, d, 5);
+	EXPECT_GT(cached.get_search_stats().cache_hits, 0u);
+	EXPECT_EQ(cached.get_search_stats().cache_misses, 0u);
+
+	// another word list read into the same dictionary object is not answered
+	// from moves found with the old one
+	{
+		ofstream words("move_cache_test_words.txt");
+		words << "at\nta\nto\non\nno\nan\nnab\nban\n";
+	}
+	d = Dictionary::read("move_cache_test_words.txt");
+	remove("move_cache_test_words.txt");
+	vector<RankedMove> top = cached.get_top_moves(b, d, 5);
+	EXPECT_EQ(cached.get_search_stats().cache_hits, 0u);
+	for (size_t i = 0; i < top.size(); ++i)
+		for (size_t j = 0; j < top[i].words.size(); ++j)
+			EXPECT_TRUE(d.is_word(top[i].words[j])) << top[i].words[j];
+}
+
+TEST_F(ComputerPlayerTest, lexicon_filter_matches_full_search) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer filtered("filtered", 7);
+	ComputerPlayer unfiltered("unfiltered", 7);
+	unfiltered.set_lexicon_filter(false);
+	filtered.set_instrumentation(true);
+	unfiltered.set_instrumentation(true);
+
+	place_concave_words(b);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+    t0.push_back(TileKind('B', 1));
+	t0.push_back(TileKind('F', 2));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('N', 3));
+	t0.push_back(TileKind('O', 7));
+	t0.push_back(TileKind('S', 4));
+	filtered.add_tiles(t0);
+	unfiltered.add_tiles(t0);
+
+	vector<RankedMove> expected = unfiltered.get_top_moves(b, d, 50);
+	vector<RankedMove> top = filtered.get_top_moves(b, d, 50);
+	ASSERT_EQ(top.size(), expected.size());
+	for (size_t i = 0; i < top.size(); ++i) {
+		EXPECT_EQ(top[i].points, expected[i].points);
+		EXPECT_TRUE(same_move(top[i].move, expected[i].move));
+	}
+
+	// the filter only visits nodes the full search would have
+	const ComputerPlayer::SearchCounters &with = filtered.get_move_counters();
+	const ComputerPlayer::SearchCounters &without = unfiltered.get_move_counters();
+	EXPECT_GT(with.subtrees_cut, 0u);
+	EXPECT_GT(with.lexicon_marks, 0u);
+	EXPECT_LT(with.nodes_expanded, without.nodes_expanded);
+	EXPECT_EQ(without.subtrees_cut, 0u);
+	EXPECT_EQ(without.lexicon_marks, 0u);
+}
+
+TEST_F(ComputerPlayerTest, bingo_bound_matches_full_search) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer bounded("bounded", 7);
+	ComputerPlayer full("full", 7);
+	full.set_pruning(false);
+
+	place_simple_word(b);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('R', 1));
+    t0.push_back(TileKind('E', 1));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('A', 1));
+	t0.push_back(TileKind('I', 1));
+	t0.push_back(TileKind('N', 1));
+	t0.push_back(TileKind('?', 0));
+	bounded.add_tiles(t0);
+	full.add_tiles(t0);
+
+	vector<RankedMove> expected = full.get_top_moves(b, d, 5);
+	vector<RankedMove> top = bounded.get_top_moves(b, d, 5);
+	ASSERT_EQ(top.size(), expected.size());
+	for (size_t i = 0; i < top.size(); ++i) {
+		EXPECT_EQ(top[i].points, expected[i].points);
+		EXPECT_TRUE(same_move(top[i].move, expected[i].move));
+	}
+	EXPECT_EQ(top[0].move.tiles.size(), 7u);
+	EXPECT_GE(bounded.get_search_stats().bingos_found, 5u);
+
+	// the bingos found up front are kept once, even when the anchors find
+	// them again
+	expected = full.get_top_moves(b, d, 40);
+	top = bounded.get_top_moves(b, d, 40);
+	ASSERT_EQ(top.size(), expected.size());
+	for (size_t i = 0; i < top.size(); ++i) {
+		EXPECT_EQ(top[i].points, expected[i].points);
+		EXPECT_TRUE(same_move(top[i].move, expected[i].move));
+		for (size_t j = 0; j < i; ++j)
+			EXPECT_FALSE(same_move(top[i].move, top[j].move));
+	}
+	EXPECT_GT(bounded.get_search_stats().anchors_pruned, 0u);
+	EXPECT_EQ(full.get_search_stats().bingos_found, 0u);
+
+	// without a full hand there is no bingo to look for
+	ComputerPlayer short_hand("short", 8);
+	short_hand.add_tiles(t0);
+	short_hand.get_move(b, d);
+	EXPECT_EQ(short_hand.get_search_stats().bingos_found, 0u);
+}
+
+TEST_F(ComputerPlayerTest, opening_book_lookup) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+
+	vector<vector<TileKind>> racks(3);
+	const char *letters[] = {"RETAINS", "QZJXKVW", "BANANA?"};
+	for (size_t i = 0; i < racks.size(); ++i)
+		for (const char *letter = letters[i]; *letter != '\0'; ++letter)
+			racks[i].push_back(TileKind(*letter, *letter == '?' ? 0 : 1));
+
+	vector<OpeningBook::Entry> entries = OpeningBook::generate(b, d, racks, 7, 2);
+	ASSERT_EQ(entries.size(), 3u);
+	OpeningBook::write("opening_book_test.bin", OpeningBook::board_hash(b), d.get_hash(), entries);
+	shared_ptr<const OpeningBook> book = OpeningBook::open("opening_book_test.bin");
+	EXPECT_EQ(book->get_entry_count(), 3u);
+	EXPECT_TRUE(book->matches(b, d));
+
+	// every rack in the book gives the move a search finds
+	for (const vector<TileKind> &rack : racks) {
+		ComputerPlayer searched("searched", 7);
+		ComputerPlayer booked("booked", 7);
+		booked.set_opening_book(book);
+		searched.add_tiles(rack);
+		booked.add_tiles(rack);
+		Move expected = searched.get_move(b, d);
+		Move m = booked.get_move(b, d);
+		EXPECT_EQ(m.kind, expected.kind);
+		if (expected.kind == MoveKind::PLACE) {
+			EXPECT_TRUE(same_move(m, expected));
+		}
+		EXPECT_EQ(booked.get_search_stats().book_hits, 1u);
+	}
+
+	// a rack not in the book is searched
+	ComputerPlayer missing("missing", 7);
+	missing.set_opening_book(book);
+	vector<TileKind> other = racks[0];
+	other[0] = TileKind('L', 1);
+	missing.add_tiles(other);
+	EXPECT_EQ(missing.get_move(b, d).kind, MoveKind::PLACE);
+	EXPECT_EQ(missing.get_search_stats().book_hits, 0u);
+
+	// so is every rack once the board is not empty
+	ComputerPlayer later("later", 7);
+	later.set_opening_book(book);
+	later.add_tiles(racks[0]);
+	Board played = b;
+	place_simple_word(played);
+	later.get_move(played, d);
+	EXPECT_EQ(later.get_search_stats().book_hits, 0u);
+
+	// a book built for another word list is not used
+	OpeningBook::write("opening_book_test.bin", OpeningBook::board_hash(b), d.get_hash() + 1, entries);
+	shared_ptr<const OpeningBook> stale = OpeningBook::open("opening_book_test.bin");
+	EXPECT_FALSE(stale->matches(b, d));
+	ComputerPlayer unbooked("unbooked", 7);
+	unbooked.set_opening_book(stale);
+	unbooked.add_tiles(racks[0]);
+	unbooked.get_move(b, d);
+	EXPECT_EQ(unbooked.get_search_stats().book_hits, 0u);
+
+	{
+		ofstream garbage("opening_book_test.bin");
+		garbage << "not a book";
+	}
+	EXPECT_THROW(OpeningBook::open("opening_book_test.bin"), FileException);
+	remove("opening_book_test.bin");
+}
+
+TEST_F(ComputerPlayerTest, position_cache_repeats) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	shared_ptr<PositionCache> cache = make_shared<PositionCache>(2);
+
+	place_concave_words(b);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+    t0.push_back(TileKind('B', 1));
+	t0.push_back(TileKind('F', 2));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('N', 3));
+	t0.push_back(TileKind('O', 7));
+	t0.push_back(TileKind('S', 4));
+
+	ComputerPlayer uncached("uncached", 7);
+	uncached.add_tiles(t0);
+	vector<RankedMove> expected = uncached.get_top_moves(b, d, 5);
+
+	// players on several threads share the cache; only the first to finish
+	// a search needs to store it
+	vector<ComputerPlayer> players(4, ComputerPlayer("cpu", 7));
+	vector<vector<RankedMove>> found(players.size());
+	vector<thread> threads;
+	for (size_t i = 0; i < players.size(); ++i) {
+		players[i].set_position_cache(cache);
+		players[i].add_tiles(t0);
+		threads.emplace_back([&, i]() {
+			found[i] = players[i].get_top_moves(b, d, 5);
+		});
+	}
+	for (thread &t : threads)
+		t.join();
+	for (const vector<RankedMove> &top : found) {
+		ASSERT_EQ(top.size(), expected.size());
+		for (size_t i = 0; i < top.size(); ++i) {
+			EXPECT_EQ(top[i].points, expected[i].points);
+			EXPECT_TRUE(same_move(top[i].move, expected[i].move));
+			EXPECT_EQ(top[i].words, expected[i].words);
+		}
+	}
+
+	// a repeat is answered from the cache
+	vector<RankedMove> again = players[0].get_top_moves(b, d, 5);
+	EXPECT_EQ(players[0].get_search_stats().position_hits, 1u);
+	ASSERT_EQ(again.size(), expected.size());
+	EXPECT_TRUE(same_move(again[0].move, expected[0].move));
+	PositionCache::Stats stats = cache->get_stats();
+	EXPECT_EQ(stats.hits + stats.misses, players.size() + 1);
+	EXPECT_GE(stats.hits, 1u);
+	EXPECT_EQ(stats.entries, 1u);
+
+	// another rack, another count or another board is another position
+	EXPECT_TRUE(same_move(players[0].get_move(b, d), expected[0].move));
+	EXPECT_EQ(players[0].get_search_stats().position_hits, 0u);
+	players[1].remove_tiles(vector<TileKind>(1, TileKind('S', 4)));
+	players[1].get_top_moves(b, d, 5);
+	EXPECT_EQ(players[1].get_search_stats().position_hits, 0u);
+	Board other = Board::read("config/standard-board.txt");
+	place_simple_word(other);
+	players[2].get_top_moves(other, d, 5);
+	EXPECT_EQ(players[2].get_search_stats().position_hits, 0u);
+
+	// the least recently used positions made room for them
+	stats = cache->get_stats();
+	EXPECT_EQ(stats.entries, 2u);
+	EXPECT_EQ(stats.evictions, 2u);
+	players[2].get_top_moves(other, d, 5);
+	EXPECT_EQ(players[2].get_search_stats().position_hits, 1u);
+	players[0].get_top_moves(b, d, 5);
+	EXPECT_EQ(players[0].get_search_stats().position_hits, 0u);
+}
+
+TEST_F(ComputerPlayerTest, instrumentation_counters) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cpu("cpu", 7);
+	cpu.set_move_cache(false);
+
+	place_concave_words(b);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+    t0.push_back(TileKind('B', 1));
+	t0.push_back(TileKind('F', 2));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('N', 3));
+	t0.push_back(TileKind('O', 7));
+	t0.push_back(TileKind('S', 4));
+	cpu.add_tiles(t0);
+
+	// nothing is counted unless enabled
+	cpu.get_move(b, d);
+	EXPECT_EQ(cpu.get_move_counters().anchors_visited, 0u);
+	EXPECT_EQ(cpu.get_game_counters().candidates_emitted, 0u);
+
+	cpu.set_instrumentation(true);
+	Move m = cpu.get_move(b, d);
+	ComputerPlayer::SearchCounters first = cpu.get_move_counters();
+	EXPECT_GT(first.anchors_visited, 0u);
+	EXPECT_GT(first.nodes_expanded, 0u);
+	EXPECT_GT(first.rack_lookups, first.nodes_expanded);
+	EXPECT_GT(first.candidates_emitted, first.candidates_rejected);
+	EXPECT_GT(first.words_validated, 0u);
+	EXPECT_GT(first.cross_word_hits, 0u);
+	EXPECT_GT(first.length_cuts, 0u);
+	EXPECT_GT(first.generation_time.count(), 0);
+	EXPECT_GT(first.scoring_time.count(), 0);
+	EXPECT_GT(first.arena_allocations, 0u);
+	EXPECT_GE(first.arena_bytes, first.arena_allocations);
+	EXPECT_EQ(first.arena_heap_blocks, 0u);
+	EXPECT_TRUE(same_move(m, cpu.get_top_moves(b, d, 1)[0].move));
+
+	// the same search again, so the game total doubles
+	EXPECT_EQ(cpu.get_move_counters().candidates_emitted, first.candidates_emitted);
+	EXPECT_EQ(cpu.get_game_counters().candidates_emitted, 2 * first.candidates_emitted);
+	EXPECT_EQ(cpu.get_game_counters().words_validated, 2 * first.words_validated);
+
+	cpu.reset_game_counters();
+	EXPECT_EQ(cpu.get_game_counters().anchors_visited, 0u);
+}
+
+TEST_F(ComputerPlayerTest, turn_arena_release) {
+	TurnArena arena(1024);
+	{
+		pmr::vector<pmr::string> words(&arena);
+		words.push_back("a word long enough not to fit in the string itself");
+		EXPECT_EQ(arena.get_allocations(), 2u);
+		EXPECT_EQ(arena.get_heap_allocations(), 0u);
+
+		// past the first block the arena takes more from the heap
+		pmr::vector<char> big(4096, 'x', &arena);
+		EXPECT_EQ(arena.get_heap_allocations(), 1u);
+		EXPECT_GE(arena.get_bytes(), 4096u);
+	}
+
+	arena.release();
+	EXPECT_EQ(arena.get_allocations(), 0u);
+	EXPECT_EQ(arena.get_bytes(), 0u);
+	EXPECT_EQ(arena.get_heap_allocations(), 0u);
+	pmr::vector<char> small(512, 'y', &arena);
+	EXPECT_EQ(arena.get_heap_allocations(), 0u);
+}
+
+TEST_F(ComputerPlayerTest, trace_events) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cpu("cpu", 7);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('A', 3));
+    t0.push_back(TileKind('B', 1));
+	t0.push_back(TileKind('F', 2));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('N', 3));
+	t0.push_back(TileKind('O', 7));
+	t0.push_back(TileKind('S', 4));
+	cpu.add_tiles(t0);
+
+	Trace::start("trace_test.json");
+	EXPECT_TRUE(Trace::enabled());
+	b.place(cpu.get_move(b, d));
+	Trace::stop();
+	EXPECT_FALSE(Trace::enabled());
+
+	// events recorded while stopped are dropped
+	b.get_anchors();
+
+	ifstream file("trace_test.json");
+	stringstream contents;
+	contents << file.rdbuf();
+	string trace = contents.str();
+	remove("trace_test.json");
+
+	EXPECT_EQ(trace.find("{\"traceEvents\":["), 0u);
+	EXPECT_NE(trace.find("\"name\":\"ComputerPlayer::get_move\""), string::npos);
+	EXPECT_NE(trace.find("\"name\":\"get_anchors\""), string::npos);
+	EXPECT_NE(trace.find("\"name\":\"left_part\""), string::npos);
+	EXPECT_NE(trace.find("\"name\":\"get_best_move\""), string::npos);
+	EXPECT_NE(trace.find("\"name\":\"Board::place\""), string::npos);
+	EXPECT_NE(trace.find("\"tid\":"), string::npos);
+	EXPECT_EQ(trace.find("\"name\":\"Board::get_anchors\""), string::npos);
+	EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}
+
+TEST_F(ComputerPlayerTest, trace_drops_span_from_earlier_trace) {
+	Trace::start("trace_test.json");
+	{
+		// begun in the first trace, ended in the second: its start would come
+		// before the second trace's origin
+		Trace::Span stale("stale_span");
+		Trace::stop();
+		Trace::start("trace_test.json");
+		Trace::Span fresh("fresh_span");
+	}
+	Trace::stop();
+
+	ifstream file("trace_test.json");
+	stringstream contents;
+	contents << file.rdbuf();
+	string trace = contents.str();
+	remove("trace_test.json");
+
+	EXPECT_NE(trace.find("\"name\":\"fresh_span\""), string::npos);
+	EXPECT_EQ(trace.find("stale_span"), string::npos);
+	EXPECT_EQ(trace.find("\"ts\":-"), string::npos);
+	EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}
+
+TEST_F(ComputerPlayerTest, trace_session_stops_on_exception) {
+	Board b = Board::read("config/standard-board.txt");
+
+	try {
+		Trace::Session trace("trace_test.json");
+		EXPECT_TRUE(Trace::enabled());
+		b.get_anchors();
+		throw MoveException("game ended early");
+	} catch (MoveException &e) {
+	}
+	EXPECT_FALSE(Trace::enabled());
+
+	ifstream file("trace_test.json");
+	stringstream contents;
+	contents << file.rdbuf();
+	string trace = contents.str();
+	remove("trace_test.json");
+
+	EXPECT_EQ(trace.find("{\"traceEvents\":["), 0u);
+	EXPECT_NE(trace.find("\"name\":\"Board::get_anchors\""), string::npos);
+	EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+
+	// no file, no trace
+	{
+		Trace::Session none("");
+		EXPECT_FALSE(Trace::enabled());
+	}
+}
+
+TEST_F(ComputerPlayerTest, candidates_unique) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cpu("cpu", 7);
+	cpu.set_pruning(false);
+
+	place_concave_words(b);
+
+	vector<TileKind> t0;
+    t0.push_back(TileKind('E', 1));
+    t0.push_back(TileKind('R', 1));
+	t0.push_back(TileKind('S', 1));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('N', 1));
+	t0.push_back(TileKind('A', 1));
+	t0.push_back(TileKind('?', 0));
+	cpu.add_tiles(t0);
+
+	// every legal move, each identified by the squares it fills and the letters
+	// placed on them
+	vector<RankedMove> all = cpu.get_top_moves(b, d, 1000000);
+	ASSERT_GT(all.size(), 1000u);
+	set<string> placements;
+	for (size_t i = 0; i < all.size(); ++i) {
+		const Move &m = all[i].move;
+		Board::Position square(m.row, m.column);
+		string placement;
+		for (size_t j = 0; j < m.tiles.size(); ++j) {
+			while (b.in_bounds_and_has_tile(square))
+				square = square.translate(m.direction);
+			placement += to_string(square.row) + "," + to_string(square.column) + m.tiles[j].letter + m.tiles[j].assigned + " ";
+			square = square.translate(m.direction);
+		}
+		EXPECT_TRUE(placements.insert(placement).second) << placement;
+	}
+}
+
+TEST_F(ComputerPlayerTest, blank_letters_chosen_per_placement) {
+	Board b = Board::read("config/standard-board.txt");
+	Dictionary d = Dictionary::read(DICT_PATH);
+	ComputerPlayer cpu("cpu", 7);
+	cpu.set_pruning(false);
+
+	place_simple_word(b);
+
+	vector<TileKind> t0;
+	t0.push_back(TileKind('A', 1));
+	t0.push_back(TileKind('T', 1));
+	t0.push_back(TileKind('?', 0));
+	t0.push_back(TileKind('?', 0));
+	cpu.add_tiles(t0);
+
+	// every blank stands for a letter, every move forms only words, and a
+	// placement is only listed once whatever its blanks could stand for
+	vector<RankedMove> all = cpu.get_top_moves(b, d, 1000000);
+	ASSERT_GT(all.size(), 100u);
+	set<string> placements;
+	for (size_t i = 0; i < all.size(); ++i) {
+		const Move &m = all[i].move;
+		string placement = to_string(m.row) + "," + to_string(m.column) + (m.direction == Direction::DOWN ? "d" : "a");
+		for (size_t j = 0; j < m.tiles.size(); ++j) {
+			placement += m.tiles[j].letter;
+			if (m.tiles[j].letter == '?') {
+				EXPECT_NE(m.tiles[j].assigned, '\0');
+			}
+		}
+		EXPECT_TRUE(placements.insert(placement).second) << placement;
+
+		PlaceResult res = b.test_place(m);
+		ASSERT_TRUE(res.valid);
+		for (size_t j = 0; j < res.words.size(); ++j)
+			EXPECT_TRUE(d.is_word(res.words[j])) << res.words[j];
+	}
+}
+
+TEST_F(ComputerPlayerTest, packed_move_round_trip) {
+	TileCollection rack;
+	rack.add_tile(TileKind('C', 3));
+	rack.add_tile(TileKind('T', 1));
+	rack.add_tile(TileKind('?', 0));
+
+	PackedMove packed(4, 9, Direction::DOWN);
+	packed.push(TileKind('C', 3));
+	packed.push(TileKind('?', 0, 'a'));
+	packed.push(TileKind('T', 1));
+	packed.pop();
+	packed.push(TileKind('T', 1));
+
+	Move m;
+	m.tiles.push_back(TileKind('Z', 10));
+	packed.unpack(rack, m);
+	EXPECT_EQ(MoveKind::PLACE, m.kind);
+	EXPECT_EQ(4u, m.row);
+	EXPECT_EQ(9u, m.column);
+	EXPECT_EQ(Direction::DOWN, m.direction);
+	ASSERT_EQ(3u, m.tiles.size());
+	EXPECT_EQ('c', m.tiles[0].letter);
+	EXPECT_EQ(3, m.tiles[0].points);
+	EXPECT_EQ('?', m.tiles[1].letter);
+	EXPECT_EQ('a', m.tiles[1].assigned);
+	EXPECT_EQ(0, m.tiles[1].points);
+	EXPECT_EQ('t', m.tiles[2].letter);
+
+	PackedRack counts(rack);
+	EXPECT_EQ(3u, counts.count_tiles());
+	EXPECT_EQ(4u, counts.total_points());
+	counts.remove_tile(counts.lookup_tile('?'));
+	EXPECT_FALSE(counts.has('?'));
+	EXPECT_TRUE(counts.has('c'));
+	EXPECT_FALSE(counts.has('a'));
+	counts.add_tile(TileKind('?', 0));
+	EXPECT_TRUE(counts.has('?'));
+	EXPECT_EQ(3u, counts.count_tiles());
+}
@@ -70,6 +70,14 @@ unsigned int TileCollection::total_points() const {
     return sum;
 }
 
+vector<TileKind> TileCollection::get_tiles() const {
+    vector<TileKind> result;
+    for (TileMap::const_iterator map_itr = tiles.begin(); map_itr != tiles.end(); map_itr++) {
+        result.insert(result.end(), map_itr->second, map_itr->first);
+    }
+    return result;
+}
+
 TileCollection::const_iterator::self_type TileCollection::const_iterator::operator++(){
     repeat_count++;
     if (repeat_count == map_itr->second){
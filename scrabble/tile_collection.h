@@ -3,6 +3,7 @@
 
 #include "tile_kind.h"
 #include <map>
+#include <cstddef>
 #include <vector>
 
 
@@ -25,6 +26,8 @@ public:
 
     unsigned int total_points() const;
 
+    std::vector<TileKind> get_tiles() const;
+
     const_iterator cbegin() const;
     const_iterator cend() const;
     
@@ -0,0 +1,193 @@
+#include "trace.h"
+#include "exceptions.h"
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Event {
+  const char *name;
+  long start_ns;
+  long duration_ns;
+  size_t thread;
+  const char *arg_keys[Trace::Span::MAX_ARGS];
+  long arg_values[Trace::Span::MAX_ARGS];
+  size_t arg_count;
+};
+
+// how often the writer thread takes the pending events
+const chrono::milliseconds WRITE_INTERVAL(50);
+
+// The running trace. Recording threads append to pending; the writer thread
+// takes everything pending at once and writes it outside the lock.
+struct TraceState {
+  atomic<bool> running{false};
+  chrono::steady_clock::time_point origin;
+  ofstream file;
+  bool first_event = true;
+
+  mutex lock;
+  condition_variable wake;
+  vector<Event> pending;
+  bool stopping = false;
+  thread writer;
+  // counts the traces started, changed only under lock
+  atomic<size_t> session{0};
+
+  // a writer still running at exit must be joined, or the program aborts
+  ~TraceState() { Trace::stop(); }
+};
+
+TraceState state;
+
+// small ids, in the order threads first record an event
+atomic<size_t> next_thread_id{1};
+
+size_t thread_id() {
+  thread_local size_t id = next_thread_id++;
+  return id;
+}
+
+void write_event(const Event &event) {
+  // Chrome trace timestamps are in microseconds
+  state.file << (state.first_event ? "\n" : ",\n");
+  state.first_event = false;
+  state.file << "{\"name\":\"" << event.name
+             << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+             << ",\"ts\":" << event.start_ns / 1000 << "."
+             << event.start_ns % 1000 / 100
+             << ",\"dur\":" << event.duration_ns / 1000 << "."
+             << event.duration_ns % 1000 / 100;
+  if (event.arg_count > 0) {
+    state.file << ",\"args\":{";
+    for (size_t i = 0; i < event.arg_count; i++) {
+      state.file << (i == 0 ? "" : ",") << "\"" << event.arg_keys[i]
+                 << "\":" << event.arg_values[i];
+    }
+    state.file << "}";
+  }
+  state.file << "}";
+}
+
+void write_pending() {
+  vector<Event> batch;
+  unique_lock<mutex> guard(state.lock);
+  while (true) {
+    state.wake.wait_for(guard, WRITE_INTERVAL, [] { return state.stopping; });
+    batch.swap(state.pending);
+    bool done = state.stopping;
+    guard.unlock();
+
+    for (const Event &event : batch) {
+      write_event(event);
+    }
+    batch.clear();
+    if (done) {
+      return;
+    }
+    guard.lock();
+  }
+}
+
+} // namespace
+
+void Trace::start(const string &file_path) {
+  stop();
+
+  state.file.open(file_path);
+  if (!state.file) {
+    throw FileException("cannot open trace file!");
+  }
+  state.file << "{\"traceEvents\":[";
+  state.first_event = true;
+  {
+    // events a span finished after the last trace stopped belong to no trace
+    lock_guard<mutex> guard(state.lock);
+    state.pending.clear();
+    state.stopping = false;
+    state.session++;
+    state.origin = chrono::steady_clock::now();
+  }
+  state.writer = thread(write_pending);
+  state.running = true;
+}
+
+void Trace::stop() {
+  if (!state.running.exchange(false)) {
+    return;
+  }
+  {
+    lock_guard<mutex> guard(state.lock);
+    state.stopping = true;
+  }
+  state.wake.notify_one();
+  state.writer.join();
+
+  state.file << "\n]}\n";
+  state.file.close();
+}
+
+bool Trace::enabled() { return state.running; }
+
+Trace::Session::Session(const string &file_path)
+    : started(!file_path.empty()) {
+  if (started) {
+    start(file_path);
+  }
+}
+
+Trace::Session::~Session() {
+  if (started) {
+    stop();
+  }
+}
+
+Trace::Span::Span(const char *name)
+    : name(name), active(Trace::enabled()), session(state.session),
+      arg_count(0) {
+  if (active) {
+    start = chrono::steady_clock::now();
+  }
+}
+
+Trace::Span::~Span() {
+  if (!active || !Trace::enabled()) {
+    return;
+  }
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+  Event event;
+  event.name = name;
+  event.duration_ns =
+      chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+  event.thread = thread_id();
+  for (size_t i = 0; i < arg_count; i++) {
+    event.arg_keys[i] = arg_keys[i];
+    event.arg_values[i] = arg_values[i];
+  }
+  event.arg_count = arg_count;
+
+  lock_guard<mutex> guard(state.lock);
+  // a span begun in an earlier trace would start before this one's origin
+  if (session != state.session) {
+    return;
+  }
+  event.start_ns =
+      chrono::duration_cast<chrono::nanoseconds>(start - state.origin).count();
+  state.pending.push_back(event);
+}
+
+void Trace::Span::arg(const char *key, long value) {
+  if (!active || arg_count == MAX_ARGS) {
+    return;
+  }
+  arg_keys[arg_count] = key;
+  arg_values[arg_count] = value;
+  arg_count++;
+}
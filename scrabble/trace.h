@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <string>
+
+/*
+Records timed events in the Chrome trace event format (viewable in
+chrome://tracing or Perfetto). Events are queued by the threads that record
+them and written to the file by a background thread, so recording one is
+cheap. While no trace is running, recording does nothing.
+*/
+class Trace {
+public:
+  /*
+  Starts writing events to file_path, replacing any trace already running.
+  Throws a FileException if the file cannot be opened.
+  */
+  static void start(const std::string &file_path);
+
+  /*
+  Writes every event recorded so far and closes the file. Does nothing if no
+  trace is running.
+  */
+  static void stop();
+
+  static bool enabled();
+
+  /*
+  A trace running for as long as the Session lives: started on construction
+  unless file_path is empty, and stopped on destruction, so that the file is
+  finished even when an exception ends the traced work.
+  */
+  class Session {
+  public:
+    explicit Session(const std::string &file_path);
+    ~Session();
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+  private:
+    bool started;
+  };
+
+  /*
+  An event lasting from construction to destruction, recorded with the id of
+  the thread it ran on.
+  */
+  class Span {
+  public:
+    static const size_t MAX_ARGS = 4;
+
+    explicit Span(const char *name);
+    ~Span();
+
+    // Attaches a value shown with the event; extra arguments are ignored.
+    void arg(const char *key, long value);
+
+  private:
+    const char *name;
+    bool active;
+    // the trace running when the span began; it is dropped if it ends in
+    // another
+    size_t session;
+    std::chrono::steady_clock::time_point start;
+    const char *arg_keys[MAX_ARGS];
+    long arg_values[MAX_ARGS];
+    size_t arg_count;
+  };
+};
+
+#endif
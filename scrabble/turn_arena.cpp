@@ -0,0 +1,58 @@
+#include "turn_arena.h"
+
+using namespace std;
+
+TurnArena::TurnArena(size_t block_size)
+    : block_size(block_size), allocations(0), bytes(0) {}
+
+TurnArena::TurnArena(const TurnArena &other) : TurnArena(other.block_size) {}
+
+TurnArena &TurnArena::operator=(const TurnArena &) { return *this; }
+
+void TurnArena::release() {
+  if (memory) {
+    memory->release();
+  }
+  upstream.allocations = 0;
+  allocations = 0;
+  bytes = 0;
+}
+
+size_t TurnArena::get_allocations() const { return allocations; }
+
+size_t TurnArena::get_bytes() const { return bytes; }
+
+size_t TurnArena::get_heap_allocations() const { return upstream.allocations; }
+
+void *TurnArena::do_allocate(size_t bytes, size_t alignment) {
+  if (!memory) {
+    block.reset(new byte[block_size]);
+    memory.emplace(block.get(), block_size, &upstream);
+  }
+  allocations++;
+  this->bytes += bytes;
+  return memory->allocate(bytes, alignment);
+}
+
+void TurnArena::do_deallocate(void *p, size_t bytes, size_t alignment) {
+  memory->deallocate(p, bytes, alignment);
+}
+
+bool TurnArena::do_is_equal(const memory_resource &other) const noexcept {
+  return this == &other;
+}
+
+void *TurnArena::Upstream::do_allocate(size_t bytes, size_t alignment) {
+  allocations++;
+  return pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void TurnArena::Upstream::do_deallocate(void *p, size_t bytes,
+                                        size_t alignment) {
+  pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool TurnArena::Upstream::do_is_equal(
+    const memory_resource &other) const noexcept {
+  return this == &other;
+}
@@ -0,0 +1,69 @@
+#ifndef TURN_ARENA_H
+#define TURN_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+/*
+Memory for the scratch data of one move search. Allocations are carved out of
+a block in order and never freed one by one; release() frees them all at once
+and keeps the first block for the next search, so a search that fits in it
+does not touch the heap at all. Only blocks the first one cannot hold are
+requested from the heap, each larger than the last. The first block is only
+allocated once something is, so an arena that is never used costs nothing.
+*/
+class TurnArena : public std::pmr::memory_resource {
+public:
+  static const size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+  explicit TurnArena(size_t block_size = DEFAULT_BLOCK_SIZE);
+
+  // Nothing allocated is copied: a copy starts out empty, and takes a block
+  // of its own when first used, so that whatever holds an arena can still be
+  // copied.
+  TurnArena(const TurnArena &other);
+  TurnArena &operator=(const TurnArena &other);
+
+  // Frees everything allocated since the last release. Containers using the
+  // arena must be destroyed first: their elements live in the freed memory.
+  void release();
+
+  /*
+  What was allocated since the last release.
+
+  allocations: requests served by the arena
+  bytes: bytes handed out for them
+  heap_allocations: blocks the arena had to take from the heap
+  */
+  size_t get_allocations() const;
+  size_t get_bytes() const;
+  size_t get_heap_allocations() const;
+
+private:
+  // Passes blocks on to the heap, counting them.
+  class Upstream : public std::pmr::memory_resource {
+  public:
+    size_t allocations = 0;
+
+  private:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const memory_resource &other) const noexcept override;
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const memory_resource &other) const noexcept override;
+
+  size_t block_size;
+  std::unique_ptr<std::byte[]> block;
+  Upstream upstream;
+  // carves allocations out of block, once there is one
+  std::optional<std::pmr::monotonic_buffer_resource> memory;
+  size_t allocations;
+  size_t bytes;
+};
+
+#endif